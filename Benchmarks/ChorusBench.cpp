@@ -0,0 +1,476 @@
+/*
+  ==============================================================================
+
+    ChorusBench.cpp
+
+    Headless offline render and benchmark. Runs the processor without an
+    editor over a matrix of sample rates, block sizes, channel layouts,
+    engines and parameter presets, and writes timing statistics as JSON so that revisions can be
+    compared.
+
+    Usage: ChorusBench [--output=results.json] [--input=file.wav | --silent-input]
+                       [--seconds=10] [--quick] [--label=revision]
+                       [--fail-on-rt-violation] [--rt-check-locks] [--telemetry]
+                       [--adaptive-quality] [--non-realtime] [--double-precision]
+                       [--kernel-level=sse2|avx2|avx512]
+
+    --silent-input feeds digital silence, which measures what an idle
+    instance costs once its tail has died away.
+
+    --telemetry reads the processor's telemetry during each run, as the
+    editor's meter does, and adds its dropped-sample and deadline counts.
+
+    --adaptive-quality turns on the quality governor and reports the tier
+    each run ended on.
+
+    --double-precision runs everything twice from double buffers, as a host
+    with a 64-bit mix engine has them: once converted to float and back
+    around the float processBlock, as such a host must for a plugin without
+    a double path, and once through the double processBlock.
+
+    --kernel-level runs on the kernels built for a lower instruction set
+    level than the CPU supports, to compare levels end to end; KernelBench
+    times the kernels on their own.
+
+    --non-realtime tells the processor the host is bouncing, as a host does
+    for an offline render, and measures that path instead of live playback.
+
+    --fail-on-rt-violation needs a build with CHORUS_REALTIME_GUARD, and
+    exits with an error after printing the stacks if processBlock allocated
+    or (with --rt-check-locks) locked a mutex in any run.
+
+  ==============================================================================
+*/
+
+#include "../Source/PluginProcessor.h"
+#include "../Source/RealtimeGuard.h"
+#include "../Source/Kernels.h"
+
+namespace
+{
+    struct EngineChoice
+    {
+        const char* name;
+        int mode;
+        bool lowLatency;
+        bool workerPool;
+    };
+
+    const EngineChoice engines[] = {
+        { "rubberband",            ChorusPluginAudioProcessor::pitchShiftEngine, false, false },
+        { "rubberband-lowlatency", ChorusPluginAudioProcessor::pitchShiftEngine, true,  false },
+        { "rubberband-workers",    ChorusPluginAudioProcessor::pitchShiftEngine, false, true },
+        { "delayline",             ChorusPluginAudioProcessor::delayLineEngine,  false, false },
+        { "granular",              ChorusPluginAudioProcessor::granularEngine,   false, false },
+    };
+
+    struct LayoutChoice
+    {
+        const char* name;
+        int numInputs;
+        int numOutputs;
+    };
+
+    const LayoutChoice layouts[] = {
+        { "mono-stereo", 1, 2 },
+        { "stereo",      2, 2 },
+    };
+
+    struct Preset
+    {
+        const char* name;
+        float delayMs;
+        int pitchCents;
+        float lfoFrequency;
+        int lfoDepth;
+        int voices;
+        int interpolation;
+        float mix = 50.0f;          // %
+        float feedback = 0.0f;      // %
+    };
+
+    const Preset presets[] = {
+        { "default",   0.0f,  5, 1.0f, 10, 1, ChorusDSP::cubicInterpolation },
+        { "wide",     15.0f, 10, 0.5f, 25, 8, ChorusDSP::cubicInterpolation },
+        { "fast",      7.5f,  0, 8.0f, 50, 4, ChorusDSP::linearInterpolation },
+        { "feedback", 10.0f,  5, 1.0f, 10, 4, ChorusDSP::cubicInterpolation, 70.0f, 60.0f },
+    };
+
+    void setParameter(ChorusPluginAudioProcessor& processor, const char* parameterID, float value)
+    {
+        auto* parameter = processor.getValueTreeState().getParameter(parameterID);
+        jassert(parameter != nullptr);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    // Parameters are set before prepareToPlay, which picks up the low-latency
+    // and worker pool modes without waiting for the message thread.
+    void applyPreset(ChorusPluginAudioProcessor& processor, const Preset& preset, const EngineChoice& engine)
+    {
+        setParameter(processor, "engine", (float) engine.mode);
+        setParameter(processor, "lowLatency", engine.lowLatency ? 1.0f : 0.0f);
+        setParameter(processor, "workerPool", engine.workerPool ? 1.0f : 0.0f);
+        setParameter(processor, "delay", preset.delayMs);
+        setParameter(processor, "pitch", (float) preset.pitchCents);
+        setParameter(processor, "lfoFrequency", preset.lfoFrequency);
+        setParameter(processor, "lfoDepth", (float) preset.lfoDepth);
+        setParameter(processor, "voices", (float) preset.voices);
+        setParameter(processor, "interpolation", (float) preset.interpolation);
+        setParameter(processor, "mix", preset.mix);
+        setParameter(processor, "feedback", preset.feedback);
+    }
+
+    enum class Precision
+    {
+        single,
+        convertedDouble,    // double buffers converted around the float processBlock
+        nativeDouble
+    };
+
+    const char* getPrecisionName(Precision precision)
+    {
+        const char* const names[] = { "float", "double-converted", "double-native" };
+        return names[(int) precision];
+    }
+
+    struct RunConfig
+    {
+        double sampleRate;
+        int blockSize;
+        const LayoutChoice* layout;
+        const EngineChoice* engine;
+        const Preset* preset;
+        bool readTelemetry;
+        bool adaptiveQuality;
+        bool nonRealtime;
+        Precision precision;
+    };
+
+    // mono source played in a loop through the processor
+    struct Source
+    {
+        juce::AudioBuffer<float> audio;
+        juce::String name;
+    };
+
+    Source makeSyntheticSource(double sampleRate, double seconds)
+    {
+        Source source;
+        source.name = "synthetic";
+        source.audio.setSize(1, (int) (sampleRate * seconds));
+
+        juce::Random random(1234);
+        auto* data = source.audio.getWritePointer(0);
+        double twoPi = juce::MathConstants<double>::twoPi;
+
+        // a chord with some noise, so neither engine sees a degenerate input
+        for (int i = 0; i < source.audio.getNumSamples(); ++i) {
+            double t = i / sampleRate;
+            data[i] = (float) (0.3 * std::sin(twoPi * 220.0 * t)
+                             + 0.2 * std::sin(twoPi * 277.2 * t)
+                             + 0.1 * std::sin(twoPi * 329.6 * t))
+                    + 0.02f * (random.nextFloat() * 2.0f - 1.0f);
+        }
+
+        return source;
+    }
+
+    bool loadSource(const juce::File& file, Source& source)
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(file));
+
+        if (reader == nullptr)
+            return false;
+
+        source.name = file.getFileName();
+        source.audio.setSize(1, (int) reader->lengthInSamples);
+        reader->read(&source.audio, 0, (int) reader->lengthInSamples, 0, true, false);
+        return true;
+    }
+
+    double percentile(const std::vector<double>& sorted, double fraction)
+    {
+        if (sorted.empty())
+            return 0.0;
+
+        auto index = (size_t) juce::jlimit(0.0, (double) sorted.size() - 1.0, std::ceil(fraction * sorted.size()) - 1.0);
+        return sorted[index];
+    }
+
+    juce::var runOne(const RunConfig& config, const Source& source, double seconds)
+    {
+        auto processor = std::make_unique<ChorusPluginAudioProcessor>();
+        applyPreset(*processor, *config.preset, *config.engine);
+        setParameter(*processor, "adaptiveQuality", config.adaptiveQuality ? 1.0f : 0.0f);
+
+        juce::AudioProcessor::BusesLayout busesLayout;
+        busesLayout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(config.layout->numInputs));
+        busesLayout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(config.layout->numOutputs));
+
+        if (! processor->setBusesLayout(busesLayout))
+            return {};
+
+        processor->setNonRealtime(config.nonRealtime);
+        processor->setProcessingPrecision(config.precision == Precision::nativeDouble ? juce::AudioProcessor::doublePrecision
+                                                                                       : juce::AudioProcessor::singlePrecision);
+        processor->setRateAndBufferSizeDetails(config.sampleRate, config.blockSize);
+        processor->prepareToPlay(config.sampleRate, config.blockSize);
+
+        std::unique_ptr<Telemetry::Reader> telemetryReader;
+
+        if (config.readTelemetry)
+            telemetryReader = std::make_unique<Telemetry::Reader>(processor->getTelemetry());
+
+        juce::AudioBuffer<float> buffer(config.layout->numOutputs, config.blockSize);
+        juce::AudioBuffer<double> doubleBuffer(config.layout->numOutputs, config.blockSize);
+        juce::MidiBuffer midi;
+
+        int numBlocks = juce::jmax(1, (int) (config.sampleRate * seconds / config.blockSize));
+        int warmupBlocks = juce::jmax(4, (int) (0.25 * config.sampleRate / config.blockSize));
+
+        std::vector<double> blockSeconds;
+        blockSeconds.reserve((size_t) numBlocks);
+
+        const auto* sourceData = source.audio.getReadPointer(0);
+        int sourceLength = source.audio.getNumSamples();
+        int sourcePosition = 0;
+
+        // further input channels play the source from a different point, so they are not identical
+        auto fillBlock = [&] {
+            for (int ch = 0; ch < config.layout->numInputs; ++ch) {
+                auto* in = buffer.getWritePointer(ch);
+                int position = (sourcePosition + ch * sourceLength / config.layout->numInputs) % sourceLength;
+
+                for (int i = 0; i < config.blockSize; ++i) {
+                    in[i] = sourceData[position];
+                    position = (position + 1) % sourceLength;
+                }
+            }
+
+            for (int ch = config.layout->numInputs; ch < buffer.getNumChannels(); ++ch)
+                buffer.clear(ch, 0, config.blockSize);
+
+            sourcePosition = (sourcePosition + config.blockSize) % sourceLength;
+
+            if (config.precision != Precision::single)
+                doubleBuffer.makeCopyOf(buffer, true);
+        };
+
+        // the conversions count as part of the block, as they do in the host
+        auto processBlock = [&] {
+            switch (config.precision) {
+            case Precision::convertedDouble:
+                buffer.makeCopyOf(doubleBuffer, true);
+                processor->processBlock(buffer, midi);
+                doubleBuffer.makeCopyOf(buffer, true);
+                break;
+            case Precision::nativeDouble:
+                processor->processBlock(doubleBuffer, midi);
+                break;
+            default:
+                processor->processBlock(buffer, midi);
+                break;
+            }
+        };
+
+        // warm-up blocks count too: an allocation there is as much a glitch in a host
+        int violationsBefore = RealtimeGuard::getNumViolations();
+
+        for (int b = 0; b < warmupBlocks; ++b) {
+            fillBlock();
+            processBlock();
+        }
+
+        double totalSeconds = 0.0;
+
+        for (int b = 0; b < numBlocks; ++b) {
+            fillBlock();
+
+            auto start = juce::Time::getHighResolutionTicks();
+            processBlock();
+            auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+            blockSeconds.push_back(elapsed);
+
+            // well inside the FIFO's capacity, and outside the timed call
+            if (telemetryReader != nullptr && b % 256 == 255)
+                telemetryReader->update();
+            totalSeconds += elapsed;
+        }
+
+        std::sort(blockSeconds.begin(), blockSeconds.end());
+
+        double deadline = config.blockSize / config.sampleRate;
+        double totalSamples = (double) numBlocks * config.blockSize;
+        int deadlineMisses = (int) (blockSeconds.end() - std::upper_bound(blockSeconds.begin(), blockSeconds.end(), deadline));
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty("layout", config.layout->name);
+        result->setProperty("engine", config.engine->name);
+        result->setProperty("preset", config.preset->name);
+        result->setProperty("precision", getPrecisionName(config.precision));
+        result->setProperty("sampleRate", config.sampleRate);
+        result->setProperty("blockSize", config.blockSize);
+        result->setProperty("blocks", numBlocks);
+        result->setProperty("nsPerSample", totalSeconds * 1.0e9 / totalSamples);
+        result->setProperty("meanBlockUs", totalSeconds * 1.0e6 / numBlocks);
+        result->setProperty("p50BlockUs", percentile(blockSeconds, 0.50) * 1.0e6);
+        result->setProperty("p90BlockUs", percentile(blockSeconds, 0.90) * 1.0e6);
+        result->setProperty("p99BlockUs", percentile(blockSeconds, 0.99) * 1.0e6);
+        result->setProperty("p999BlockUs", percentile(blockSeconds, 0.999) * 1.0e6);
+        result->setProperty("worstBlockUs", blockSeconds.back() * 1.0e6);
+        result->setProperty("deadlineUs", deadline * 1.0e6);
+        result->setProperty("worstToDeadline", blockSeconds.back() / deadline);
+        result->setProperty("deadlineMisses", deadlineMisses);
+        result->setProperty("realtimeFactor", totalSamples / config.sampleRate / totalSeconds);
+        result->setProperty("latencySamples", processor->getLatencySamples());
+        result->setProperty("latencyMs", processor->getLatencySamples() * 1000.0 / config.sampleRate);
+        result->setProperty("rtViolations", RealtimeGuard::getNumViolations() - violationsBefore);
+        result->setProperty("qualityTier", processor->getQualityTier());
+
+        if (telemetryReader != nullptr) {
+            telemetryReader->update();
+            result->setProperty("telemetryPeakLoad", telemetryReader->getPeakLoad());
+            result->setProperty("telemetryDeadlineMisses", telemetryReader->getDeadlineMisses());
+            result->setProperty("droppedSamples", telemetryReader->getDroppedSamples());
+            result->setProperty("telemetryLostRecords", telemetryReader->getLostRecords());
+        }
+
+        return juce::var(result);
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    bool quick = args.containsOption("--quick");
+    double seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : (quick ? 2.0 : 10.0);
+    juce::String label = args.getValueForOption("--label");
+    bool failOnViolation = args.containsOption("--fail-on-rt-violation");
+
+    if (failOnViolation && ! RealtimeGuard::isEnabled) {
+        std::fprintf(stderr, "--fail-on-rt-violation needs a build with CHORUS_REALTIME_GUARD\n");
+        return 1;
+    }
+
+    RealtimeGuard::setDetectLocks(args.containsOption("--rt-check-locks"));
+    bool readTelemetry = args.containsOption("--telemetry");
+    bool adaptiveQuality = args.containsOption("--adaptive-quality");
+    bool nonRealtime = args.containsOption("--non-realtime");
+
+    if (args.containsOption("--kernel-level")) {
+        auto name = args.getValueForOption("--kernel-level");
+        bool forced = false;
+
+        for (int level = Kernels::baseline; level < Kernels::numLevels; ++level)
+            if (name == Kernels::getLevelName((Kernels::Level) level))
+                forced = Kernels::forceLevel((Kernels::Level) level);
+
+        if (! forced) {
+            std::fprintf(stderr, "Kernel level %s is not available on this CPU\n", name.toRawUTF8());
+            return 1;
+        }
+    }
+
+    std::vector<Precision> precisions = args.containsOption("--double-precision")
+                                      ? std::vector<Precision>{ Precision::convertedDouble, Precision::nativeDouble }
+                                      : std::vector<Precision>{ Precision::single };
+
+    std::vector<double> sampleRates = quick ? std::vector<double>{ 48000.0 }
+                                            : std::vector<double>{ 44100.0, 48000.0, 96000.0 };
+    std::vector<int> blockSizes = quick ? std::vector<int>{ 64, 512 }
+                                        : std::vector<int>{ 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+
+    Source fileSource;
+    bool useFile = false;
+    bool silentInput = args.containsOption("--silent-input");
+
+    if (args.containsOption("--input")) {
+        juce::File inputFile(args.getValueForOption("--input"));
+
+        if (! loadSource(inputFile, fileSource)) {
+            std::fprintf(stderr, "Could not read %s\n", inputFile.getFullPathName().toRawUTF8());
+            return 1;
+        }
+
+        useFile = true;
+    }
+
+    juce::var results;
+
+    for (auto sampleRate : sampleRates) {
+        // a file plays at whatever rate the run uses; it is only a signal to chew on
+        Source source = useFile ? fileSource : makeSyntheticSource(sampleRate, 5.0);
+
+        if (silentInput) {
+            source.audio.clear();
+            source.name = "silence";
+        }
+
+        for (auto blockSize : blockSizes)
+            for (auto& layout : layouts)
+                for (auto& engine : engines)
+                    for (auto& preset : presets)
+                        for (auto precision : precisions) {
+                            RunConfig config{ sampleRate, blockSize, &layout, &engine, &preset, readTelemetry, adaptiveQuality, nonRealtime, precision };
+                            auto result = runOne(config, source, seconds);
+
+                            auto* object = result.getDynamicObject();
+
+                            if (object == nullptr) {
+                                std::fprintf(stderr, "Layout %s not supported\n", layout.name);
+                                continue;
+                            }
+
+                            object->setProperty("input", source.name);
+
+                            std::fprintf(stderr, "%-11s %-22s %-8s %-16s %6.0f Hz %5d  %8.2f ns/sample  worst %8.1f us (%.0f%% of deadline)  latency %6.2f ms\n",
+                                         layout.name, engine.name, preset.name, getPrecisionName(precision), sampleRate, blockSize,
+                                         (double) object->getProperty("nsPerSample"),
+                                         (double) object->getProperty("worstBlockUs"),
+                                         100.0 * (double) object->getProperty("worstToDeadline"),
+                                         (double) object->getProperty("latencyMs"));
+
+                            results.append(result);
+                        }
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("label", label);
+    report->setProperty("timestamp", juce::Time::getCurrentTime().toISO8601(true));
+    report->setProperty("cpu", juce::SystemStats::getCpuModel());
+    report->setProperty("os", juce::SystemStats::getOperatingSystemName());
+    report->setProperty("secondsPerRun", seconds);
+    report->setProperty("nonRealtime", nonRealtime);
+    report->setProperty("kernelLevel", Kernels::getLevelName(Kernels::getActiveLevel()));
+    report->setProperty("realtimeGuard", RealtimeGuard::isEnabled);
+    report->setProperty("rtViolations", RealtimeGuard::getNumViolations());
+    report->setProperty("results", results);
+
+    auto json = juce::JSON::toString(juce::var(report));
+
+    if (args.containsOption("--output")) {
+        juce::File outputFile(args.getValueForOption("--output"));
+
+        if (! outputFile.replaceWithText(json)) {
+            std::fprintf(stderr, "Could not write %s\n", outputFile.getFullPathName().toRawUTF8());
+            return 1;
+        }
+    }
+    else {
+        std::printf("%s\n", json.toRawUTF8());
+    }
+
+    if (failOnViolation && RealtimeGuard::getNumViolations() > 0) {
+        RealtimeGuard::dumpViolations(stderr);
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    FootprintCheck.cpp
+
+    Instantiates and prepares many processors and reports the resident memory
+    they add, so a regression in per-instance footprint shows up without a DAW.
+
+    Usage: FootprintCheck [numInstances] [sampleRate] [blockSize]
+
+  ==============================================================================
+*/
+
+#include "../Source/PluginProcessor.h"
+
+#if JUCE_LINUX
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+static size_t getResidentBytes()
+{
+   #if JUCE_LINUX
+    size_t totalPages = 0, residentPages = 0;
+
+    if (auto* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%zu %zu", &totalPages, &residentPages) != 2)
+            residentPages = 0;
+        std::fclose(statm);
+    }
+
+    return residentPages * (size_t) sysconf(_SC_PAGESIZE);
+   #else
+    return 0;
+   #endif
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    int numInstances = argc > 1 ? std::atoi(argv[1]) : 64;
+    double sampleRate = argc > 2 ? std::atof(argv[2]) : 48000.0;
+    int blockSize = argc > 3 ? std::atoi(argv[3]) : 512;
+
+    // generous ceiling for the history of one instance: 200 ms at 192 kHz plus a large block is ~256k samples
+    const size_t historyBudgetBytes = 1 << 20;
+
+    size_t residentBefore = getResidentBytes();
+
+    std::vector<std::unique_ptr<ChorusPluginAudioProcessor>> processors;
+    size_t historyBytes = 0;
+
+    for (int i = 0; i < numInstances; ++i) {
+        auto processor = std::make_unique<ChorusPluginAudioProcessor>();
+        processor->setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor->prepareToPlay(sampleRate, blockSize);
+        historyBytes = processor->getHistoryFootprintBytes();
+        processors.push_back(std::move(processor));
+    }
+
+    size_t residentAfter = getResidentBytes();
+    double residentPerInstance = numInstances > 0 ? (double) (residentAfter - residentBefore) / numInstances : 0.0;
+
+    std::printf("instances:            %d\n", numInstances);
+    std::printf("sample rate / block:  %.0f / %d\n", sampleRate, blockSize);
+    std::printf("history per instance: %.1f KiB\n", historyBytes / 1024.0);
+    std::printf("RSS per instance:     %.1f KiB%s\n", residentPerInstance / 1024.0,
+                residentAfter == 0 ? " (not available on this platform)" : "");
+
+    if (historyBytes > historyBudgetBytes) {
+        std::printf("FAIL: history exceeds %zu bytes per instance\n", historyBudgetBytes);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+  ==============================================================================
+
+    KernelBench.cpp
+
+    Times every kernel in the Kernels registry at each instruction set level
+    this CPU supports, and checks that every level produces exactly the
+    same output as the baseline. Reports the speed-up over the baseline,
+    as JSON.
+
+    Usage: KernelBench [--output=results.json] [--block-size=512]
+                       [--seconds=1] [--voices=4]
+
+    Exits with an error if any level's output differs from the baseline's.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../Source/Kernels.h"
+#include "../Source/DelayInterpolation.h"
+
+namespace
+{
+    enum KernelId
+    {
+        copyKernel = 0,
+        convertKernel,
+        writeFeedbackKernel,
+        writeFeedbackFromDoubleKernel,
+        linearKernel,
+        cubicKernel,
+        allpassKernel,
+        sumVoicesKernel,
+        mixKernel,
+        mixToDoubleKernel,
+        mixSplitKernel,
+        mixSplitToDoubleKernel,
+        numKernels
+    };
+
+    const char* const kernelNames[] = { "copy", "convert", "write-feedback", "write-feedback-double",
+                                        "read-linear", "read-cubic", "read-allpass", "sum-voices",
+                                        "mix", "mix-double", "mix-split", "mix-split-double" };
+
+    // gains gliding through the block, as the smoothers hand them over
+    const Kernels::Ramp feedbackGain { 0.25f, 0.0005f };
+    const Kernels::Ramp dryGain { 1.0f, -0.0004f };
+    const Kernels::Ramp wetGain { 0.5f, 0.0003f };
+
+    // Inputs shared by every level, so their outputs can be compared
+    struct TestData
+    {
+        TestData(int blockSize, int numVoices)
+            : size(blockSize), voices(numVoices), lanes(numVoices == 1 ? 1 : numVoices <= 4 ? 4 : 8)
+        {
+            juce::Random random(1234);
+            windowLength = 4 * blockSize + 64;
+
+            window.resize((size_t) windowLength);
+            for (auto& x : window)
+                x = random.nextFloat() * 2.0f - 1.0f;
+
+            doubleInput.resize((size_t) blockSize);
+            for (auto& x : doubleInput)
+                x = random.nextDouble() * 2.0 - 1.0;
+
+            // a sweep over a range of delays, as the LFOs make them, laid out
+            // a lane per voice as the voice bank hands them over
+            delays.resize((size_t) (lanes * blockSize));
+            for (int i = 0; i < blockSize; ++i)
+                for (int v = 0; v < lanes; ++v)
+                    delays[(size_t) (i * lanes + v)] = (float) DelayInterpolation::minimumDelay
+                                                     + (float) blockSize * (1.0f + std::sin(0.01f * (float) i + (float) v));
+
+            taps.resize((size_t) (lanes * blockSize));
+            for (auto& x : taps)
+                x = random.nextFloat() * 2.0f - 1.0f;
+
+            // the padding lanes past the last voice are silent
+            gains.resize((size_t) lanes);
+            for (int v = 0; v < lanes; ++v)
+                gains[(size_t) v] = v < numVoices ? 0.5f : 0.0f;
+        }
+
+        int size, voices, lanes, windowLength;
+        std::vector<float> window, delays, taps, gains;
+        std::vector<double> doubleInput;
+    };
+
+    // runs a kernel once over a block; returns its output for the comparison
+    std::vector<double> runKernel(const Kernels& kernels, KernelId id, const TestData& data,
+                                  std::vector<float>& out, std::vector<double>& doubleOut, float* state)
+    {
+        int n = data.size;
+        const float* window = data.window.data();
+        const float* wet = window + n;
+        const double* doubleInput = data.doubleInput.data();
+        int position = data.windowLength - n - DelayInterpolation::maximumOvershoot;
+
+        // the split kernels write their right channel after the left
+        float* right = out.data() + n;
+        double* doubleRight = doubleOut.data() + n;
+
+        switch (id) {
+        case copyKernel:                    kernels.copy(out.data(), window, n); break;
+        case convertKernel:                 kernels.convert(out.data(), doubleInput, n); break;
+        case writeFeedbackKernel:           kernels.writeFeedback(out.data(), window, wet, feedbackGain, n); break;
+        case writeFeedbackFromDoubleKernel: kernels.writeFeedbackFromDouble(out.data(), doubleInput, wet, feedbackGain, n); break;
+        case mixKernel:                     kernels.mix(out.data(), window, wet, dryGain, wetGain, n); break;
+        case mixToDoubleKernel:             kernels.mixToDouble(doubleOut.data(), doubleInput, wet, dryGain, wetGain, n); break;
+        case mixSplitKernel:                kernels.mixSplit(out.data(), right, window, wet, dryGain, wetGain, n); break;
+        case mixSplitToDoubleKernel:        kernels.mixSplitToDouble(doubleOut.data(), doubleRight, doubleInput, wet, dryGain, wetGain, n); break;
+
+        case sumVoicesKernel:               kernels.sumVoices(out.data(), data.taps.data(), data.gains.data(), data.lanes, n); break;
+        case linearKernel:                  kernels.readLinear(window, position, data.delays.data(), out.data(), data.lanes, n); break;
+        case cubicKernel:                   kernels.readCubic(window, position, data.delays.data(), out.data(), data.lanes, n); break;
+        case allpassKernel:                 kernels.readAllpass(window, position, data.delays.data(), out.data(), data.lanes, n, state); break;
+        default:                            break;
+        }
+
+        if (id == mixToDoubleKernel || id == mixSplitToDoubleKernel)
+            return doubleOut;
+
+        return std::vector<double>(out.begin(), out.end());
+    }
+
+    struct Result
+    {
+        double nsPerSample;
+        std::vector<double> output;     // of the first block
+    };
+
+    Result runOne(Kernels::Level level, KernelId id, const TestData& data, double seconds)
+    {
+        auto& kernels = *Kernels::getForLevel(level);
+        // room for the split kernels' two channels, or for a tap per lane
+        std::vector<float> out((size_t) (juce::jmax(2, data.lanes) * data.size), 0.0f);
+        std::vector<double> doubleOut((size_t) (2 * data.size), 0.0);
+        float state[8] = {};
+
+        Result result;
+        result.output = runKernel(kernels, id, data, out, doubleOut, state);
+
+        // the accumulating kernels keep adding to the same block, which is
+        // fine for timing; a block's worth of random input never overflows
+        int numBlocks = juce::jmax(1, (int) (48000.0 * seconds / data.size));
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (int b = 0; b < numBlocks; ++b)
+            runKernel(kernels, id, data, out, doubleOut, state);
+
+        auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        result.nsPerSample = elapsed * 1.0e9 / ((double) numBlocks * data.size);
+        return result;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    int blockSize = args.containsOption("--block-size") ? juce::jmax(16, args.getValueForOption("--block-size").getIntValue()) : 512;
+    double seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : 1.0;
+    int numVoices = args.containsOption("--voices") ? juce::jlimit(1, 8, args.getValueForOption("--voices").getIntValue()) : 4;
+
+    std::fprintf(stderr, "Kernels at %s, the highest level this CPU supports\n",
+                 Kernels::getLevelName(Kernels::getSupportedLevel()));
+
+    TestData data(blockSize, numVoices);
+    juce::var results;
+    int mismatches = 0;
+
+    for (int id = 0; id < numKernels; ++id) {
+        auto baseline = runOne(Kernels::baseline, (KernelId) id, data, seconds);
+
+        for (int level = Kernels::baseline; level < Kernels::numLevels; ++level) {
+            if (Kernels::getForLevel((Kernels::Level) level) == nullptr)
+                continue;
+
+            auto result = level == Kernels::baseline ? baseline : runOne((Kernels::Level) level, (KernelId) id, data, seconds);
+            bool matches = result.output == baseline.output;
+            mismatches += matches ? 0 : 1;
+
+            std::fprintf(stderr, "%-22s %-8s %7.3f ns/sample  %5.2fx  %s\n",
+                         kernelNames[id], Kernels::getLevelName((Kernels::Level) level), result.nsPerSample,
+                         baseline.nsPerSample / result.nsPerSample, matches ? "matches" : "DIFFERS");
+
+            auto* object = new juce::DynamicObject();
+            object->setProperty("kernel", kernelNames[id]);
+            object->setProperty("level", Kernels::getLevelName((Kernels::Level) level));
+            object->setProperty("blockSize", blockSize);
+            object->setProperty("nsPerSample", result.nsPerSample);
+            object->setProperty("speedup", baseline.nsPerSample / result.nsPerSample);
+            object->setProperty("matchesBaseline", matches);
+            results.append(juce::var(object));
+        }
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("cpu", juce::SystemStats::getCpuModel());
+    report->setProperty("supportedLevel", Kernels::getLevelName(Kernels::getSupportedLevel()));
+    report->setProperty("results", results);
+
+    auto json = juce::JSON::toString(juce::var(report));
+
+    if (args.containsOption("--output")) {
+        juce::File outputFile(args.getValueForOption("--output"));
+
+        if (! outputFile.replaceWithText(json)) {
+            std::fprintf(stderr, "Could not write %s\n", outputFile.getFullPathName().toRawUTF8());
+            return 1;
+        }
+    }
+    else {
+        std::printf("%s\n", json.toRawUTF8());
+    }
+
+    if (mismatches > 0) {
+        std::fprintf(stderr, "%d kernel outputs differ from the baseline\n", mismatches);
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,195 @@
+/*
+  ==============================================================================
+
+    RingBench.cpp
+
+    Microbenchmark of the history ring access pattern of processBlock: write
+    one block per channel, then read a dry and a wet tap back from varying
+    delays. Compares the split copy that handles wrap-around in two parts with
+    the mirrored HistoryRing, both copying its taps out and consuming them in
+    place.
+
+    Usage: RingBench [--output=results.json] [--channels=2] [--seconds=2]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../Source/HistoryRing.h"
+
+namespace
+{
+    // The ring as it was before mirroring: every access that crosses the end
+    // of the buffer is split into two copies.
+    class SplitCopyRing
+    {
+    public:
+        void prepare(int numChannels, int maxDelaySamples, int maxBlockSize)
+        {
+            size = juce::nextPowerOfTwo(maxDelaySamples + maxBlockSize);
+            mask = size - 1;
+            buffer.setSize(numChannels, size);
+            buffer.clear();
+            writePosition = 0;
+        }
+
+        void write(int channel, const float* source, int numSamples)
+        {
+            auto* data = buffer.getWritePointer(channel);
+            int first = juce::jmin(numSamples, size - writePosition);
+
+            juce::FloatVectorOperations::copy(data + writePosition, source, first);
+            juce::FloatVectorOperations::copy(data, source + first, numSamples - first);
+        }
+
+        void advance(int numSamples) { writePosition = (writePosition + numSamples) & mask; }
+
+        void read(int channel, int delaySamples, float* dest, int numSamples) const
+        {
+            auto* data = buffer.getReadPointer(channel);
+            int start = (writePosition - delaySamples) & mask;
+            int first = juce::jmin(numSamples, size - start);
+
+            juce::FloatVectorOperations::copy(dest, data + start, first);
+            juce::FloatVectorOperations::copy(dest + first, data, numSamples - first);
+        }
+
+    private:
+        juce::AudioBuffer<float> buffer;
+        int size = 0, mask = 0, writePosition = 0;
+    };
+
+    enum Method
+    {
+        splitCopy = 0,
+        mirroredCopy,
+        mirroredInPlace
+    };
+
+    const char* const methodNames[] = { "split-copy", "mirrored-copy", "mirrored-in-place" };
+
+    struct Result
+    {
+        double nsPerSample;
+        float checksum; // keeps the consumers from being optimised away
+    };
+
+    Result runOne(Method method, int numChannels, int blockSize, double seconds)
+    {
+        const double sampleRate = 48000.0;
+        const int maxDelay = (int) (sampleRate * 0.2);
+
+        SplitCopyRing splitRing;
+        HistoryRing history;
+        splitRing.prepare(numChannels, maxDelay, blockSize);
+        history.prepare(numChannels, maxDelay, blockSize);
+
+        juce::AudioBuffer<float> input(numChannels, blockSize), taps(numChannels, blockSize);
+        juce::Random random(42);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                input.setSample(ch, i, random.nextFloat() - 0.5f);
+
+        // the taps move every block, as the LFO-swept wet tap does, so wraps
+        // land at every offset within a block
+        std::vector<int> delays(1024);
+        for (auto& delay : delays)
+            delay = random.nextInt(maxDelay + 1);
+
+        int numBlocks = juce::jmax(1, (int) (sampleRate * seconds / blockSize));
+        float checksum = 0.0f;
+
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (int b = 0; b < numBlocks; ++b) {
+            int dryDelay = delays[(size_t) b & 1023];
+            int wetDelay = delays[(size_t) (b + 511) & 1023];
+
+            for (int ch = 0; ch < numChannels; ++ch) {
+                auto* tap = taps.getWritePointer(ch);
+
+                if (method == splitCopy) {
+                    splitRing.write(ch, input.getReadPointer(ch), blockSize);
+                    splitRing.read(ch, dryDelay, tap, blockSize);
+                    checksum += tap[blockSize - 1];
+                    splitRing.read(ch, wetDelay, tap, blockSize);
+                    checksum += tap[0];
+                }
+                else if (method == mirroredCopy) {
+                    history.write(ch, input.getReadPointer(ch), blockSize);
+                    history.read(ch, dryDelay, tap, blockSize);
+                    checksum += tap[blockSize - 1];
+                    history.read(ch, wetDelay, tap, blockSize);
+                    checksum += tap[0];
+                }
+                else {
+                    history.write(ch, input.getReadPointer(ch), blockSize);
+                    juce::FloatVectorOperations::add(tap, history.getReadWindow(ch, dryDelay),
+                                                     history.getReadWindow(ch, wetDelay), blockSize);
+                    checksum += tap[blockSize - 1];
+                }
+            }
+
+            splitRing.advance(blockSize);
+            history.advance(blockSize);
+        }
+
+        auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+        return { elapsed * 1.0e9 / ((double) numBlocks * blockSize * numChannels), checksum };
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    int numChannels = args.containsOption("--channels") ? juce::jlimit(1, HistoryRing::maxChannels, args.getValueForOption("--channels").getIntValue()) : 2;
+    double seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : 2.0;
+
+    {
+        HistoryRing probe;
+        probe.prepare(1, 1, 1);
+        std::fprintf(stderr, "HistoryRing is %s\n", probe.isMirrored() ? "mirrored" : "using the copying fallback");
+    }
+
+    juce::var results;
+
+    for (int blockSize : { 32, 64, 128, 256, 512, 1024, 2048, 4096 })
+        for (int method = splitCopy; method <= mirroredInPlace; ++method) {
+            auto result = runOne((Method) method, numChannels, blockSize, seconds);
+
+            std::fprintf(stderr, "%-18s %5d  %7.3f ns/sample  (%g)\n",
+                         methodNames[method], blockSize, result.nsPerSample, (double) result.checksum);
+
+            auto* object = new juce::DynamicObject();
+            object->setProperty("method", methodNames[method]);
+            object->setProperty("blockSize", blockSize);
+            object->setProperty("channels", numChannels);
+            object->setProperty("nsPerSample", result.nsPerSample);
+            results.append(juce::var(object));
+        }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("cpu", juce::SystemStats::getCpuModel());
+    report->setProperty("results", results);
+
+    auto json = juce::JSON::toString(juce::var(report));
+
+    if (args.containsOption("--output")) {
+        juce::File outputFile(args.getValueForOption("--output"));
+
+        if (! outputFile.replaceWithText(json)) {
+            std::fprintf(stderr, "Could not write %s\n", outputFile.getFullPathName().toRawUTF8());
+            return 1;
+        }
+    }
+    else {
+        std::printf("%s\n", json.toRawUTF8());
+    }
+
+    return 0;
+}
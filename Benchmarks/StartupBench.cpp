@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    StartupBench.cpp
+
+    Times what a host does to the plugin while a session loads: construct
+    many instances and prepare each, then prepare them all again as on a
+    transport start, and once more after a buffer size change. Reports the
+    time per instance for each step and engine, as JSON.
+
+    Usage: StartupBench [--output=results.json] [--instances=16]
+                        [--sample-rate=48000] [--block-size=512]
+
+  ==============================================================================
+*/
+
+#include "../Source/PluginProcessor.h"
+
+namespace
+{
+    struct EngineChoice
+    {
+        const char* name;
+        int mode;
+    };
+
+    const EngineChoice engines[] = {
+        { "rubberband", ChorusPluginAudioProcessor::pitchShiftEngine },
+        { "delayline",  ChorusPluginAudioProcessor::delayLineEngine },
+    };
+
+    struct Timings
+    {
+        double constructMs = 0.0;   // per instance
+        double prepareMs = 0.0;
+        double reprepareMs = 0.0;   // same rate and block size
+        double resizeMs = 0.0;      // after a block size change
+    };
+
+    double millisecondsSince(juce::int64 startTicks)
+    {
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks) * 1000.0;
+    }
+
+    Timings runOne(const EngineChoice& engine, int numInstances, double sampleRate, int blockSize)
+    {
+        std::vector<std::unique_ptr<ChorusPluginAudioProcessor>> processors;
+        Timings timings;
+
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numInstances; ++i) {
+            auto processor = std::make_unique<ChorusPluginAudioProcessor>();
+
+            auto* parameter = processor->getValueTreeState().getParameter("engine");
+            parameter->setValueNotifyingHost(parameter->convertTo0to1((float) engine.mode));
+
+            processors.push_back(std::move(processor));
+        }
+
+        timings.constructMs = millisecondsSince(start) / numInstances;
+
+        auto prepareAll = [&](int size) {
+            auto prepareStart = juce::Time::getHighResolutionTicks();
+
+            for (auto& processor : processors) {
+                processor->setRateAndBufferSizeDetails(sampleRate, size);
+                processor->prepareToPlay(sampleRate, size);
+            }
+
+            return millisecondsSince(prepareStart) / numInstances;
+        };
+
+        timings.prepareMs = prepareAll(blockSize);
+        timings.reprepareMs = prepareAll(blockSize);
+        timings.resizeMs = prepareAll(juce::jmax(16, blockSize / 2));
+
+        return timings;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    int numInstances = args.containsOption("--instances") ? juce::jmax(1, args.getValueForOption("--instances").getIntValue()) : 16;
+    double sampleRate = args.containsOption("--sample-rate") ? args.getValueForOption("--sample-rate").getDoubleValue() : 48000.0;
+    int blockSize = args.containsOption("--block-size") ? juce::jmax(16, args.getValueForOption("--block-size").getIntValue()) : 512;
+
+    juce::var results;
+
+    for (auto& engine : engines) {
+        auto timings = runOne(engine, numInstances, sampleRate, blockSize);
+
+        std::fprintf(stderr, "%-10s construct %7.3f ms  prepare %7.3f ms  again %7.3f ms  resized %7.3f ms  (per instance)\n",
+                     engine.name, timings.constructMs, timings.prepareMs, timings.reprepareMs, timings.resizeMs);
+
+        auto* object = new juce::DynamicObject();
+        object->setProperty("engine", engine.name);
+        object->setProperty("instances", numInstances);
+        object->setProperty("sampleRate", sampleRate);
+        object->setProperty("blockSize", blockSize);
+        object->setProperty("constructMs", timings.constructMs);
+        object->setProperty("prepareMs", timings.prepareMs);
+        object->setProperty("constructAndPrepareMs", timings.constructMs + timings.prepareMs);
+        object->setProperty("reprepareMs", timings.reprepareMs);
+        object->setProperty("resizeMs", timings.resizeMs);
+        results.append(juce::var(object));
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("cpu", juce::SystemStats::getCpuModel());
+    report->setProperty("results", results);
+
+    auto json = juce::JSON::toString(juce::var(report));
+
+    if (args.containsOption("--output")) {
+        juce::File outputFile(args.getValueForOption("--output"));
+
+        if (! outputFile.replaceWithText(json)) {
+            std::fprintf(stderr, "Could not write %s\n", outputFile.getFullPathName().toRawUTF8());
+            return 1;
+        }
+    }
+    else {
+        std::printf("%s\n", json.toRawUTF8());
+    }
+
+    return 0;
+}
@@ -0,0 +1,777 @@
+/*
+  ==============================================================================
+
+    ChorusDSP.cpp
+
+  ==============================================================================
+*/
+
+#include "ChorusDSP.h"
+#include "HistoryRing.h"
+#include "MixKernels.h"
+#include "ControlScheduler.h"
+#include "SilenceDetector.h"
+#include "QualityGovernor.h"
+#include "RubberBandEngine.h"
+#include "DelayLineEngine.h"
+#include "GranularEngine.h"
+
+static_assert(ChorusDSP::maxChannels == HistoryRing::maxChannels, "the public channel limit must match the history");
+static_assert(ChorusDSP::maxVoices == VoiceBank::maxVoices, "the public voice limit must match the voice bank");
+static_assert(ChorusDSP::maxPitchCents + ChorusDSP::maxLfoDepthCents <= ChorusEngine::maxSweepCents,
+              "the pitch shifter's latency bound must cover the whole pitch range");
+static_assert((int) ChorusDSP::cubicInterpolation == (int) DelayInterpolation::cubic
+              && (int) ChorusDSP::allpassInterpolation == (int) DelayInterpolation::allpass, "interpolation types must match");
+
+//==============================================================================
+/**
+*/
+class ChorusDSP::Impl
+{
+public:
+    void prepare(double newSampleRate, int maxBlockSize, int numInputChannels, int numOutputChannels,
+                 const Options& newOptions, const Parameters& params);
+    bool needsPrepare(const Options& newOptions) const;
+    template <typename SampleType>
+    int process(const SampleType* const* input, SampleType* const* output, int numSamples);
+
+    void setNonRealtime(bool isNonRealtime);
+
+    void setParameters(const Parameters& params);
+    int getLatencySamples() const { return wetLatency.load(std::memory_order_relaxed); }
+    double getTailLengthSeconds() const;
+    void setIdleHoldBlocks(int numBlocks) { silenceDetector.setHoldBlocks(numBlocks); }
+    bool isIdle() const { return silenceDetector.isIdle(); }
+    int getQualityTier() const { return qualityTier.load(std::memory_order_relaxed); }
+    size_t getHistoryFootprintBytes() const;
+
+private:
+    // one block of at most the prepared size
+    template <typename SampleType>
+    int processBlock(const SampleType* const* input, SampleType* const* output, int numSamples);
+
+    // The history the engines read carries feedback, so the dry taps have a
+    // ring of their own; double blocks keep theirs in double so the dry
+    // signal is not rounded
+    template <typename SampleType>
+    BasicHistoryRing<SampleType>& getDryHistory()
+    {
+        if constexpr (std::is_same<SampleType, float>::value)
+            return inputHistory;
+        else
+            return doubleHistory;
+    }
+
+    // scratch for the dry taps, two channels long: one that glides, and
+    // the crossfade between two through a change of engine
+    template <typename SampleType>
+    SampleType* getDryGlideBuffer()
+    {
+        if constexpr (std::is_same<SampleType, float>::value)
+            return dryGlideBuffer.get();
+        else
+            return doubleDryGlideBuffer.get();
+    }
+
+    // the dry tap's delay for negative delays, in whole samples so that it
+    // reads in place once it has stopped moving
+    float getDryOffsetSamples() const { return (float) juce::roundToInt(juce::jmax(0.0f, -parameters.delayMs) * sampleRate / 1000.0); }
+
+    // a smoother's glide over the next numSamples, for the kernels to apply sample by sample
+    static Kernels::Ramp getRamp(juce::SmoothedValue<float>& smoothed, int numSamples)
+    {
+        float start = smoothed.getCurrentValue();
+        float end = smoothed.skip(numSamples);
+        return { start, (end - start) / (float) numSamples };
+    }
+
+    // holds the pitch and its LFO to the range the pitch shifter's latency is bounded for
+    void limitParameters();
+
+    // Brings the history and engine back from idle when the input returns
+    void resumeFromIdle();
+
+    // Sets the smoothers' targets from the parameters and fills params from
+    // their current values; called at every control tick.
+    void updateEngineParameters();
+
+    // the mix control fades out one side past its middle; the output gain scales both
+    float getDryGain() const { return juce::jmin(1.0f, 2.0f * (1.0f - parameters.mix)) * outputGain; }
+    float getWetGain() const { return juce::jmin(1.0f, 2.0f * parameters.mix) * outputGain; }
+    float getFeedback() const { return juce::jlimit(0.0f, maxFeedback, parameters.feedback); }
+    void updateOutputGain();
+
+    // the engine that renders the wet signal for an engine mode and quality tier
+    ChorusEngine& getEngine(int mode, int tier);
+
+    int getWetLatencySamples() const;
+    int getLatencyPadding(const ChorusEngine& engine) const;
+
+    // bit mask of the quality tiers that change anything for the selected engine and voices
+    int getAvailableTiers() const;
+
+    // control tick for one engine, with the latency padding and voices it runs with
+    void tickEngine(ChorusEngine& engine, int padding, ChorusEngine::Parameters& params);
+
+    // The active engine keeps running alongside the incoming one until the
+    // crossfade between them has finished, and then goes on standby. An
+    // engine still fading out is brought straight back.
+    void startCrossfade(ChorusEngine& incoming, int previousPadding);
+    void applyCrossfade(float* const* wet, const float* const* outgoing, int numChannels, int numSamples);
+
+    double sampleRate = 0.0;
+    int preparedBlockSize = 0;
+    int numOutputs = 0;
+    bool splitDryWet = false;   // mono in, stereo out: dry on the left, wet on the right
+    Options options;
+    Parameters parameters;
+    bool nonRealtime = false;   // the host is bouncing, not playing
+
+    // continuous parameters glide to their targets so automation does not zipper
+    juce::SmoothedValue<float> smoothedDelay;
+    juce::SmoothedValue<float> smoothedPitch;
+    juce::SmoothedValue<float> smoothedLfoFrequency;
+    juce::SmoothedValue<float> smoothedLfoDepth;
+    juce::SmoothedValue<float> smoothedDryGain;     // mix and output gain together
+    juce::SmoothedValue<float> smoothedWetGain;
+    juce::SmoothedValue<float> smoothedFeedback;
+    juce::SmoothedValue<float> smoothedDryOffset;   // samples
+    float outputGainDb = 0.0f;
+    float outputGain = 1.0f;
+    std::atomic<float> tailFeedback{ 0.0f };        // for the tail length, read off the audio thread
+    std::atomic<int> wetLatency{ 0 };               // for the host, likewise
+    ChorusEngine::Parameters engineParameters;
+    ChorusEngine::Parameters activeParameters;      // as the active engine got them
+    ChorusEngine::Parameters fadingParameters;
+
+    // One ring holds the input history for both the dry and the wet tap
+    HistoryRing history;
+    BasicHistoryRing<double> doubleHistory;     // dry signal of double blocks
+    juce::AudioBuffer<float> pitchShiftBuffer;  // wet voice for one block
+    juce::HeapBlock<float> dryGlideBuffer;
+    juce::HeapBlock<double> doubleDryGlideBuffer;
+
+    // Feedback adds the wet signal from one control tick earlier to the
+    // input as it goes into the history; a tick is the longest run between
+    // two writes, so that wet signal is always ready. Float blocks then need
+    // a ring of their own for the dry taps. Both rings are built at every
+    // prepare, so turning feedback up never has to wait for them.
+    HistoryRing feedbackHistory;
+    HistoryRing inputHistory;
+    int feedbackDelaySamples = 0;
+
+    ControlScheduler controlScheduler;
+    RubberBandEngine pitchShifter;
+    RubberBandEngine fastPitchShifter;  // the speed pitch mode, the first tier below it
+    DelayLineEngine delayLine;
+    DelayLineEngine reducedDelayLine;   // stands in for either engine at the lower quality tiers
+    GranularEngine granular;
+    int currentEngineMode = pitchShiftEngine;
+
+    QualityGovernor governor;
+    int currentTier = QualityGovernor::full;
+    std::atomic<int> qualityTier{ QualityGovernor::full };
+    int pitchShiftLatency = 0;  // kept by every engine in the pitch shift mode
+
+    ChorusEngine* activeEngine = &pitchShifter;
+    ChorusEngine* fadingEngine = nullptr;   // outgoing engine during a crossfade
+    int fadingPadding = 0;
+    int fadeHoldSamples = 0;
+    int fadeSamplesRemaining = 0;
+    int fadeLengthSamples = 1;
+    juce::AudioBuffer<float> fadeBuffer;    // outgoing engine's wet signal
+    juce::HeapBlock<float> fadeGains;
+    static constexpr double crossfadeMs = 30.0;
+
+    SilenceDetector silenceDetector;
+};
+
+//==============================================================================
+void ChorusDSP::Impl::prepare(double newSampleRate, int maxBlockSize, int numInputChannels, int numOutputChannels,
+                              const Options& newOptions, const Parameters& params)
+{
+    sampleRate = newSampleRate;
+    preparedBlockSize = maxBlockSize;
+    options = newOptions;
+    parameters = params;
+    limitParameters();
+
+    // every input channel gets its own history and engine state
+    int numChannels = juce::jlimit(1, HistoryRing::maxChannels, numInputChannels);
+    numOutputs = juce::jlimit(1, HistoryRing::maxChannels, numOutputChannels);
+    splitDryWet = numChannels == 1 && numOutputs == 2;
+    jassert(splitDryWet || numChannels == numOutputs);
+
+    // glides are short enough to feel immediate but long enough to hide automation steps
+    for (auto* smoothed : { &smoothedDelay, &smoothedPitch, &smoothedLfoFrequency, &smoothedLfoDepth,
+                            &smoothedDryGain, &smoothedWetGain, &smoothedFeedback, &smoothedDryOffset })
+        smoothed->reset(sampleRate, 0.05);
+
+    tailFeedback.store(getFeedback(), std::memory_order_relaxed);
+    updateOutputGain();
+
+    smoothedDelay.setCurrentAndTargetValue(parameters.delayMs);
+    smoothedPitch.setCurrentAndTargetValue(parameters.pitchCents);
+    smoothedLfoFrequency.setCurrentAndTargetValue(parameters.lfoFrequency);
+    smoothedLfoDepth.setCurrentAndTargetValue(parameters.lfoDepthCents);
+    smoothedDryGain.setCurrentAndTargetValue(getDryGain());
+    smoothedWetGain.setCurrentAndTargetValue(getWetGain());
+    smoothedFeedback.setCurrentAndTargetValue(getFeedback());
+    smoothedDryOffset.setCurrentAndTargetValue(getDryOffsetSamples());
+
+    controlScheduler.prepare(sampleRate);
+    pitchShifter.setLowLatency(options.lowLatency);
+    pitchShifter.setUseWorkerPool(options.workerPool);
+    fastPitchShifter.setLowLatency(options.lowLatency);
+    fastPitchShifter.setUseWorkerPool(options.workerPool);
+    fastPitchShifter.setFastPitch(true);
+    currentEngineMode = params.engine;
+
+    // The stretcher is built whatever the engine, as picking the pitch
+    // shifter later must not stop playback to build it. Preparing again with
+    // the same rate and channels reuses whatever was built before.
+    pitchShifter.setCentreCents(parameters.pitchCents);
+    pitchShifter.prepare(sampleRate, maxBlockSize, numChannels, controlScheduler.getTickRate());
+    pitchShiftLatency = pitchShifter.getLatencySamples();
+
+    // The governor's first step down crossfades to a second stretcher in
+    // the speed mode, as rbs cannot change modes without a click. Whichever
+    // of the two primes with less delay reads the history further back.
+    if (options.adaptiveQuality) {
+        fastPitchShifter.setCentreCents(parameters.pitchCents);
+        fastPitchShifter.prepare(sampleRate, maxBlockSize, numChannels, controlScheduler.getTickRate());
+        pitchShiftLatency = juce::jmax(pitchShiftLatency, fastPitchShifter.getLatencySamples());
+    }
+    else {
+        fastPitchShifter.releaseJobs();
+    }
+
+    delayLine.prepare(sampleRate, maxBlockSize, numChannels, controlScheduler.getTickRate());
+    reducedDelayLine.prepare(sampleRate, maxBlockSize, numChannels, controlScheduler.getTickRate());
+    reducedDelayLine.setInterpolation(DelayInterpolation::linear);
+    granular.prepare(sampleRate, maxBlockSize, numChannels, controlScheduler.getTickRate());
+
+    governor.prepare(sampleRate);
+    pitchShifter.setNonRealtime(nonRealtime);
+    fastPitchShifter.setNonRealtime(nonRealtime);
+    currentTier = QualityGovernor::full;
+    qualityTier = currentTier;
+    activeEngine = &getEngine(currentEngineMode, currentTier);
+    wetLatency.store(getWetLatencySamples(), std::memory_order_relaxed);
+    fadingEngine = nullptr;
+    fadeLengthSamples = juce::jmax(1, (int) (sampleRate * crossfadeMs / 1000.0));
+    fadeGains.allocate((size_t) maxBlockSize, false);
+
+    // the history only has to reach back as far as the longest delay plus the
+    // delay-line sweep or a grain, or the dry tap plus the pitch shifter's
+    // latency, plus the block being written. A delay line standing in for
+    // the pitch shifter is held back by its latency on top of the sweep.
+    int pitchShiftReach = pitchShifter.getMaxLatencySamples() + pitchShiftLatency - pitchShifter.getLatencySamples();
+
+    if (options.adaptiveQuality)
+        pitchShiftReach = juce::jmax(pitchShiftReach, fastPitchShifter.getMaxLatencySamples() + pitchShiftLatency - fastPitchShifter.getLatencySamples());
+    int headroom = juce::jmax(DelayLineEngine::getRequiredHeadroom(sampleRate), GranularEngine::getRequiredHeadroom(sampleRate));
+    int maxDelaySamples = (int) std::ceil(sampleRate * maxDelayMs / 1000.0)
+                        + (options.adaptiveQuality ? headroom + pitchShiftReach : juce::jmax(headroom, pitchShiftReach));
+    history.prepare(numChannels, maxDelaySamples, maxBlockSize);
+
+    dryGlideBuffer.allocate((size_t) (2 * maxBlockSize), false);
+
+    if (options.doublePrecision) {
+        doubleHistory.prepare(numChannels, maxDelaySamples, maxBlockSize);
+        doubleDryGlideBuffer.allocate((size_t) (2 * maxBlockSize), false);
+    }
+    else {
+        doubleHistory.release();
+        doubleDryGlideBuffer.free();
+    }
+
+    feedbackDelaySamples = controlScheduler.getTickInterval();
+    feedbackHistory.prepare(numChannels, feedbackDelaySamples, maxBlockSize);
+
+    if (options.doublePrecision)
+        inputHistory.release();
+    else
+        inputHistory.prepare(numChannels, maxDelaySamples, maxBlockSize);
+
+    pitchShiftBuffer.setSize(numChannels, maxBlockSize, false, false, true);
+    fadeBuffer.setSize(numChannels, maxBlockSize, false, false, true);
+    silenceDetector.prepare(history.getMaxDelay());
+}
+
+bool ChorusDSP::Impl::needsPrepare(const Options& newOptions) const
+{
+    // rbs fixes its window size at construction and the worker pool changes
+    // the latency, so both rebuild the pitch shifter. The adaptive quality
+    // needs a longer history, and double blocks a dry ring in double.
+    return newOptions.lowLatency != options.lowLatency
+        || newOptions.workerPool != options.workerPool
+        || newOptions.adaptiveQuality != options.adaptiveQuality
+        || newOptions.doublePrecision != options.doublePrecision;
+}
+
+double ChorusDSP::Impl::getTailLengthSeconds() const
+{
+    // The farthest any tap reaches back covers the delay either side, the
+    // sweep and the stretcher's latency. Before the first prepare there is
+    // only the delay range, with a generous allowance for the rest.
+    if (sampleRate <= 0.0 || history.getMaxDelay() == 0)
+        return maxDelayMs / 1000.0 + 0.1;
+
+    double tailSeconds = history.getMaxDelay() / sampleRate;
+    float feedback = tailFeedback.load(std::memory_order_relaxed);
+
+    // Feedback goes round the loop until it falls below the silence
+    // threshold, taking at most the history's reach plus a tick each time
+    if (feedback > 0.0f) {
+        double passes = std::log((double) SilenceDetector::defaultThreshold) / std::log((double) feedback);
+        tailSeconds += passes * (history.getMaxDelay() + feedbackDelaySamples) / sampleRate;
+    }
+
+    return tailSeconds;
+}
+
+size_t ChorusDSP::Impl::getHistoryFootprintBytes() const
+{
+    return history.getFootprintBytes() + doubleHistory.getFootprintBytes()
+         + feedbackHistory.getFootprintBytes() + inputHistory.getFootprintBytes()
+         + (size_t) (pitchShiftBuffer.getNumChannels() * pitchShiftBuffer.getNumSamples()) * sizeof(float);
+}
+
+void ChorusDSP::Impl::resumeFromIdle()
+{
+    // Nothing but silence was in reach of the taps when processing stopped,
+    // so a cleared history carries on where it left off. So does the engine,
+    // which had nothing but silence through it for as long as the history
+    // reaches. Its state is that of a freshly reset one, a primed stretcher
+    // included, so nothing is reset, or primed, at the onset that wakes it.
+    // The smoothers jump to the parameters that moved in the meantime.
+    history.reset();
+    doubleHistory.reset();
+    feedbackHistory.reset();
+    inputHistory.reset();
+    controlScheduler.reset();
+
+    if (fadingEngine != nullptr) {
+        fadingEngine->standby();
+        fadingEngine = nullptr;
+    }
+
+    smoothedDelay.setCurrentAndTargetValue(parameters.delayMs);
+    smoothedPitch.setCurrentAndTargetValue(parameters.pitchCents);
+    smoothedLfoFrequency.setCurrentAndTargetValue(parameters.lfoFrequency);
+    smoothedLfoDepth.setCurrentAndTargetValue(parameters.lfoDepthCents);
+
+    updateOutputGain();
+    smoothedDryGain.setCurrentAndTargetValue(getDryGain());
+    smoothedWetGain.setCurrentAndTargetValue(getWetGain());
+    smoothedFeedback.setCurrentAndTargetValue(getFeedback());
+    smoothedDryOffset.setCurrentAndTargetValue(getDryOffsetSamples());
+}
+
+void ChorusDSP::Impl::setParameters(const Parameters& params)
+{
+    parameters = params;
+    limitParameters();
+    tailFeedback.store(getFeedback(), std::memory_order_relaxed);
+}
+
+void ChorusDSP::Impl::limitParameters()
+{
+    parameters.pitchCents = juce::jlimit(-maxPitchCents, maxPitchCents, parameters.pitchCents);
+    parameters.lfoDepthCents = juce::jlimit(0.0f, maxLfoDepthCents, parameters.lfoDepthCents);
+}
+
+void ChorusDSP::Impl::updateOutputGain()
+{
+    // decibels only need converting when they move
+    if (parameters.outputGainDb != outputGainDb) {
+        outputGainDb = parameters.outputGainDb;
+        outputGain = juce::Decibels::decibelsToGain(outputGainDb);
+    }
+}
+
+void ChorusDSP::Impl::updateEngineParameters()
+{
+    updateOutputGain();
+
+    smoothedDelay.setTargetValue(parameters.delayMs);
+    smoothedPitch.setTargetValue(parameters.pitchCents);
+    smoothedLfoFrequency.setTargetValue(parameters.lfoFrequency);
+    smoothedLfoDepth.setTargetValue(parameters.lfoDepthCents);
+    smoothedDryGain.setTargetValue(getDryGain());
+    smoothedWetGain.setTargetValue(getWetGain());
+    smoothedFeedback.setTargetValue(getFeedback());
+    smoothedDryOffset.setTargetValue(getDryOffsetSamples());
+
+    // positive delays hold back the wet tap, negative ones the dry tap
+    float delayMs = smoothedDelay.getCurrentValue();
+
+    engineParameters.delaySamples = juce::jmax(0.0f, delayMs) * (float) sampleRate / 1000.0f;
+    engineParameters.pitchCents = smoothedPitch.getCurrentValue();
+    engineParameters.lfoFrequency = smoothedLfoFrequency.getCurrentValue();
+    engineParameters.lfoDepthCents = smoothedLfoDepth.getCurrentValue();
+    engineParameters.numVoices = parameters.numVoices;
+}
+
+int ChorusDSP::Impl::getWetLatencySamples() const
+{
+    return activeEngine->getLatencySamples() + getLatencyPadding(*activeEngine);
+}
+
+int ChorusDSP::Impl::getLatencyPadding(const ChorusEngine& engine) const
+{
+    // the host compensates for the pitch shifter's latency, which the
+    // engines standing in for it keep by reading further back
+    if (currentEngineMode == pitchShiftEngine
+        && (&engine == &pitchShifter || &engine == &fastPitchShifter || &engine == &reducedDelayLine))
+        return pitchShiftLatency - engine.getLatencySamples();
+
+    return 0;
+}
+
+int ChorusDSP::Impl::getAvailableTiers() const
+{
+    int tiers = 1 << QualityGovernor::full;
+
+    if (currentEngineMode == pitchShiftEngine)
+        tiers |= (1 << QualityGovernor::fastPitch) | (1 << QualityGovernor::delayLine);
+    else if (currentEngineMode == delayLineEngine && parameters.numVoices > 1)
+        tiers |= 1 << QualityGovernor::fewerVoices;
+
+    return tiers;
+}
+
+void ChorusDSP::Impl::tickEngine(ChorusEngine& engine, int padding, ChorusEngine::Parameters& params)
+{
+    params = engineParameters;
+    params.delaySamples += (float) padding;
+
+    // the stand-in delay line runs a single voice for the pitch shifter and
+    // half the voices for the full delay line
+    if (&engine == &reducedDelayLine)
+        params.numVoices = currentEngineMode == pitchShiftEngine ? 1 : juce::jmax(1, params.numVoices / 2);
+
+    engine.controlTick(params);
+}
+
+void ChorusDSP::Impl::startCrossfade(ChorusEngine& incoming, int previousPadding)
+{
+    if (&incoming == fadingEngine) {
+        // the fade turns round from wherever it had got to
+        int remaining = fadeHoldSamples > 0 ? fadeLengthSamples : fadeSamplesRemaining;
+        std::swap(activeParameters, fadingParameters);
+        fadingEngine = activeEngine;
+        fadingPadding = previousPadding;
+        activeEngine = &incoming;
+        wetLatency.store(getWetLatencySamples(), std::memory_order_relaxed);
+        fadeHoldSamples = 0;
+        fadeSamplesRemaining = fadeLengthSamples - remaining;
+        return;
+    }
+
+    fadingEngine = activeEngine;
+    fadingPadding = previousPadding;
+    fadingParameters = activeParameters;
+    activeEngine = &incoming;
+    wetLatency.store(getWetLatencySamples(), std::memory_order_relaxed);
+    tickEngine(incoming, getLatencyPadding(incoming), activeParameters);
+
+    // RubberBand was primed with silence on standby, so it only fades in
+    // once its latency has passed
+    fadeHoldSamples = incoming.getLatencySamples();
+    fadeSamplesRemaining = fadeLengthSamples;
+}
+
+void ChorusDSP::Impl::applyCrossfade(float* const* wet, const float* const* outgoing, int numChannels, int numSamples)
+{
+    auto* gains = fadeGains.get();
+
+    for (int i = 0; i < numSamples; ++i) {
+        if (fadeHoldSamples > 0) {
+            --fadeHoldSamples;
+            gains[i] = 0.0f;
+        }
+        else {
+            fadeSamplesRemaining = juce::jmax(0, fadeSamplesRemaining - 1);
+            gains[i] = 1.0f - (float) fadeSamplesRemaining / (float) fadeLengthSamples;
+        }
+    }
+
+    // outgoing + gain * (incoming - outgoing)
+    for (int ch = 0; ch < numChannels; ++ch) {
+        juce::FloatVectorOperations::subtract(wet[ch], outgoing[ch], numSamples);
+        juce::FloatVectorOperations::multiply(wet[ch], gains, numSamples);
+        juce::FloatVectorOperations::add(wet[ch], outgoing[ch], numSamples);
+    }
+
+    if (fadeHoldSamples == 0 && fadeSamplesRemaining == 0) {
+        fadingEngine->standby();
+        fadingEngine = nullptr;
+    }
+}
+
+ChorusEngine& ChorusDSP::Impl::getEngine(int mode, int tier)
+{
+    if (mode == pitchShiftEngine && tier < QualityGovernor::fastPitch)
+        return pitchShifter;
+
+    // only built, and only stepped to, with the adaptive quality
+    if (mode == pitchShiftEngine && tier < QualityGovernor::delayLine)
+        return fastPitchShifter;
+
+    if (mode == delayLineEngine && tier < QualityGovernor::fewerVoices)
+        return delayLine;
+
+    // already cheaper than any tier below it
+    if (mode == granularEngine)
+        return granular;
+
+    return reducedDelayLine;
+}
+
+void ChorusDSP::Impl::setNonRealtime(bool isNonRealtime)
+{
+    if (isNonRealtime == nonRealtime)
+        return;
+
+    nonRealtime = isNonRealtime;
+    pitchShifter.setNonRealtime(nonRealtime);
+    fastPitchShifter.setNonRealtime(nonRealtime);
+
+    // nothing is late in a bounce, so it runs at full quality throughout and
+    // the governor starts over from there when playback resumes
+    governor.reset();
+    currentTier = QualityGovernor::full;
+    qualityTier.store(currentTier, std::memory_order_relaxed);
+}
+
+template <typename SampleType>
+int ChorusDSP::Impl::process(const SampleType* const* input, SampleType* const* output, int numSamples)
+{
+    if (numSamples <= preparedBlockSize)
+        return processBlock(input, output, numSamples);
+
+    // Hosts bouncing offline may hand over longer blocks than they prepared
+    // for; every buffer is sized for the prepared block, so those go through
+    // in pieces
+    const SampleType* inputPiece[HistoryRing::maxChannels];
+    SampleType* outputPiece[HistoryRing::maxChannels];
+    int samplesRetrieved = 0;
+
+    for (int start = 0; start < numSamples; start += preparedBlockSize) {
+        for (int ch = 0; ch < history.getNumChannels(); ++ch)
+            inputPiece[ch] = input[ch] + start;
+
+        for (int ch = 0; ch < numOutputs; ++ch)
+            outputPiece[ch] = output[ch] + start;
+
+        samplesRetrieved += processBlock(inputPiece, outputPiece, juce::jmin(preparedBlockSize, numSamples - start));
+    }
+
+    return samplesRetrieved;
+}
+
+template <typename SampleType>
+int ChorusDSP::Impl::processBlock(const SampleType* const* input, SampleType* const* output, int bufferLength)
+{
+    juce::ScopedNoDenormals noDenormals;
+    auto& dryHistory = getDryHistory<SampleType>();
+    jassert(dryHistory.getNumChannels() == history.getNumChannels());
+
+    // a bounce has no deadline to measure against
+    bool governed = options.adaptiveQuality && ! nonRealtime;
+    auto startTicks = governed ? juce::Time::getHighResolutionTicks() : 0;
+    int numChannels = history.getNumChannels();
+    jassert(bufferLength <= pitchShiftBuffer.getNumSamples());
+
+    const SampleType* inputData[HistoryRing::maxChannels];
+    float* pitchShiftOutputData[HistoryRing::maxChannels];
+    float* fadeOutputData[HistoryRing::maxChannels];
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        inputData[ch] = input[ch];
+        pitchShiftOutputData[ch] = pitchShiftBuffer.getWritePointer(ch);
+        fadeOutputData[ch] = fadeBuffer.getWritePointer(ch);
+    }
+
+    // output channels without an input of their own carry nothing but the split wet signal
+    for (int ch = splitDryWet ? 2 : numChannels; ch < numOutputs; ++ch)
+        juce::FloatVectorOperations::clear(output[ch], bufferLength);
+
+    // A newly selected engine, or one the quality governor has stepped to,
+    // crossfades with the one it replaces. It waits until it is ready, which
+    // for a stretcher means primed on a worker since it was last used, and
+    // until any crossfade under way has finished, unless it is the engine
+    // fading out.
+    int previousPadding = getLatencyPadding(*activeEngine);
+    auto& selectedEngine = getEngine(parameters.engine, currentTier);
+
+    if (&selectedEngine == activeEngine) {
+        currentEngineMode = parameters.engine;
+    }
+    else if ((fadingEngine == nullptr || &selectedEngine == fadingEngine) && selectedEngine.isReady()) {
+        currentEngineMode = parameters.engine;
+        startCrossfade(selectedEngine, previousPadding);
+    }
+
+    delayLine.setInterpolation(parameters.interpolation);
+
+    int samplesRetrieved = bufferLength;
+
+    // once the input and everything it left in the history have died away
+    // there is nothing to compute, so idle instances cost one peak scan
+    bool wasIdle = silenceDetector.isIdle();
+
+    if (silenceDetector.process(inputData, numChannels, bufferLength)) {
+        for (int ch = 0; ch < numOutputs; ++ch)
+            juce::FloatVectorOperations::clear(output[ch], bufferLength);
+    }
+    else {
+        if (wasIdle)
+            resumeFromIdle();
+
+        samplesRetrieved = 0;
+
+        auto& engine = *activeEngine;
+        int padding = getLatencyPadding(engine);
+
+        // the block is cut at the control ticks, so the LFO advances with time rather than with host blocks
+        controlScheduler.process(bufferLength,
+            [&] {
+                updateEngineParameters();
+                tickEngine(engine, padding, activeParameters);
+
+                if (fadingEngine != nullptr)
+                    tickEngine(*fadingEngine, fadingPadding, fadingParameters);
+            },
+            [&](int start, int numSamples) {
+                // the input has to be in the history before the output overwrites it
+                auto feedbackGain = getRamp(smoothedFeedback, numSamples);
+                bool feeding = feedbackGain.start != 0.0f || feedbackGain.step != 0.0f;
+
+                for (int ch = 0; ch < numChannels; ++ch) {
+                    if (feeding)
+                        history.write(ch, inputData[ch] + start, feedbackHistory.getReadWindow(ch, feedbackDelaySamples), feedbackGain, numSamples);
+                    else
+                        history.write(ch, inputData[ch] + start, numSamples);
+
+                    dryHistory.write(ch, inputData[ch] + start, numSamples);
+                }
+
+                // every channel is rendered in one pass so they share the modulation work
+                samplesRetrieved += engine.process(history, activeParameters, pitchShiftOutputData, numChannels, numSamples);
+
+                // the fading engine's latency is taken before the end of its fade lets go of it
+                auto dryLatency = (float) (engine.getLatencySamples() + padding);
+                auto fadingDryLatency = fadingEngine != nullptr ? (float) (fadingEngine->getLatencySamples() + fadingPadding) : dryLatency;
+
+                if (fadingEngine != nullptr) {
+                    fadingEngine->process(history, fadingParameters, fadeOutputData, numChannels, numSamples);
+                    applyCrossfade(pitchShiftOutputData, fadeOutputData, numChannels, numSamples);
+                }
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                    feedbackHistory.write(ch, pitchShiftOutputData[ch], numSamples);
+
+                // what goes round the loop keeps the engines running as the input would
+                if (feeding)
+                    silenceDetector.processFeedback(pitchShiftOutputData, numChannels, numSamples);
+
+                // Dry taps are held back by the wet path's latency so the two
+                // line up, and by negative delays. Those glide sample by
+                // sample between whole-sample delays, so automating them does
+                // not zipper. Through a change of engine the dry signal
+                // crossfades between the two latencies with the same gains
+                // as the wet one.
+                auto dryOffset = getRamp(smoothedDryOffset, numSamples);
+                auto maxDryDelay = (float) (history.getMaxDelay() - 1);
+
+                auto readDry = [&](int ch, float latency, SampleType* buffer) -> const SampleType* {
+                    float dryStart = juce::jmin(latency + dryOffset.start, maxDryDelay);
+                    float dryEnd = juce::jmin(latency + dryOffset.start + dryOffset.step * (float) numSamples, maxDryDelay);
+                    Kernels::Ramp dryDelay { dryStart, (dryEnd - dryStart) / (float) numSamples };
+
+                    if (dryDelay.step == 0.0f)
+                        return dryHistory.getReadWindow(ch, (int) dryDelay.start);
+
+                    MixKernels::readGliding(buffer, dryHistory.getReadWindow(ch, history.getMaxDelay()), history.getMaxDelay(),
+                                            dryDelay, numSamples);
+                    return buffer;
+                };
+
+                auto getDry = [&](int ch) -> const SampleType* {
+                    auto* dry = readDry(ch, dryLatency, getDryGlideBuffer<SampleType>());
+
+                    if (fadingDryLatency == dryLatency)
+                        return dry;
+
+                    auto* faded = getDryGlideBuffer<SampleType>() + preparedBlockSize;
+                    MixKernels::crossfade(faded, readDry(ch, fadingDryLatency, faded), dry, fadeGains.get(), numSamples);
+                    return faded;
+                };
+
+                auto dryGain = getRamp(smoothedDryGain, numSamples);
+                auto wetGain = getRamp(smoothedWetGain, numSamples);
+
+                // one pass per channel reads the dry tap, in place unless it
+                // is gliding, and the wet signal once, and writes the output
+                if (splitDryWet) {
+                    // the wet signal only has the right channel to itself, so the voices are summed rather than panned
+                    MixKernels::mixSplit(output[0] + start, output[1] + start, getDry(0),
+                                         pitchShiftOutputData[0], dryGain, wetGain, numSamples);
+                }
+                else {
+                    for (int ch = 0; ch < numChannels; ++ch)
+                        MixKernels::mix(output[ch] + start, getDry(ch), pitchShiftOutputData[ch], dryGain, wetGain, numSamples);
+                }
+
+                // ----------------------------------
+                history.advance(numSamples);
+                dryHistory.advance(numSamples);
+                feedbackHistory.advance(numSamples);
+
+                for (auto* smoothed : { &smoothedDelay, &smoothedPitch, &smoothedLfoFrequency, &smoothedLfoDepth })
+                    smoothed->skip(numSamples);
+            });
+
+        // the worker pool gets the whole block's input at once
+        engine.endBlock(history, activeParameters);
+
+        if (fadingEngine != nullptr)
+            fadingEngine->endBlock(history, fadingParameters);
+    }
+
+    // idle blocks say nothing about what the engines cost
+    if (governed && ! silenceDetector.isIdle()) {
+        double processSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        double deadlineSeconds = bufferLength / sampleRate;
+
+        currentTier = governor.update((float) (processSeconds / deadlineSeconds), bufferLength, getAvailableTiers());
+        qualityTier.store(currentTier, std::memory_order_relaxed);
+    }
+
+    return samplesRetrieved;
+}
+
+//==============================================================================
+ChorusDSP::ChorusDSP() : impl(std::make_unique<Impl>()) {}
+ChorusDSP::~ChorusDSP() = default;
+
+void ChorusDSP::prepare(double sampleRate, int maxBlockSize, int numInputChannels, int numOutputChannels,
+                        const Options& options, const Parameters& params)
+{
+    impl->prepare(sampleRate, maxBlockSize, numInputChannels, numOutputChannels, options, params);
+}
+
+bool ChorusDSP::needsPrepare(const Options& options) const                { return impl->needsPrepare(options); }
+void ChorusDSP::setParameters(const Parameters& params)                   { impl->setParameters(params); }
+int ChorusDSP::process(const float* const* input, float* const* output, int numSamples) { return impl->process(input, output, numSamples); }
+int ChorusDSP::process(const double* const* input, double* const* output, int numSamples) { return impl->process(input, output, numSamples); }
+void ChorusDSP::setNonRealtime(bool isNonRealtime)                        { impl->setNonRealtime(isNonRealtime); }
+int ChorusDSP::getLatencySamples() const                                  { return impl->getLatencySamples(); }
+double ChorusDSP::getTailLengthSeconds() const                            { return impl->getTailLengthSeconds(); }
+void ChorusDSP::setIdleHoldBlocks(int numBlocks)                          { impl->setIdleHoldBlocks(numBlocks); }
+bool ChorusDSP::isIdle() const                                            { return impl->isIdle(); }
+int ChorusDSP::getQualityTier() const                                     { return impl->getQualityTier(); }
+size_t ChorusDSP::getHistoryFootprintBytes() const                        { return impl->getHistoryFootprintBytes(); }
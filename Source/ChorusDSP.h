@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    ChorusDSP.h
+
+    The chorus signal path - input history, modulation, engines, crossfades,
+    feedback and the output mix - behind a plain C++ interface, so that batch tools
+    can run the effect without the plugin wrapper. The plugin processor maps
+    its parameters onto it and adds the host-facing parts.
+
+    This header includes nothing from JUCE; everything behind it lives in
+    ChorusDSP.cpp.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+//==============================================================================
+/**
+*/
+class ChorusDSP
+{
+public:
+    enum EngineMode
+    {
+        pitchShiftEngine = 0,   // RubberBand, high consistency
+        delayLineEngine,        // modulated fractional delay, low CPU and no latency
+        granularEngine          // overlapping grains, small detunes at low latency
+    };
+
+    enum InterpolationType
+    {
+        linearInterpolation = 0,
+        cubicInterpolation,     // 4-point cubic Hermite
+        allpassInterpolation
+    };
+
+    // Continuous settings glide to new values; the engine switches with a
+    // short crossfade.
+    struct Parameters
+    {
+        float delayMs = 0.0f;           // negative values delay the dry tap instead
+        float pitchCents = 5.0f;
+        float lfoFrequency = 1.0f;      // Hz
+        float lfoDepthCents = 10.0f;
+        int numVoices = 1;              // delay-line engine only
+        int engine = pitchShiftEngine;
+        int interpolation = cubicInterpolation;   // delay-line engine only
+        float mix = 0.5f;               // 0 dry only, 1 wet only; both at full level in the middle
+        float feedback = 0.0f;          // share of the wet signal fed back into the history, up to maxFeedback
+        float outputGainDb = 0.0f;
+    };
+
+    // Settings that only change with the next prepare()
+    struct Options
+    {
+        bool lowLatency = false;        // short RubberBand windows, about half the latency
+        bool workerPool = false;        // stretch a block ahead on threads shared by every instance
+        bool adaptiveQuality = false;   // step down to cheaper tiers when blocks run late
+        bool doublePrecision = false;   // blocks come in as double
+    };
+
+    static constexpr double maxDelayMs = 200.0;     // delay range, either side of zero
+    static constexpr int maxChannels = 8;
+    static constexpr int maxVoices = 8;
+    static constexpr float maxFeedback = 0.9f;
+    static constexpr float maxPitchCents = 25.0f;       // pitch range, either side of zero
+    static constexpr float maxLfoDepthCents = 100.0f;
+
+    ChorusDSP();
+    ~ChorusDSP();
+
+    // Not realtime safe. Every input channel is chorused in place, so the
+    // output channels must match, except that one input to two outputs keeps
+    // the dry signal on the left and the wet on the right. Every engine and
+    // the rings feedback needs are built here, so that no parameter change
+    // needs another prepare.
+    void prepare(double sampleRate, int maxBlockSize, int numInputChannels, int numOutputChannels,
+                 const Options& options, const Parameters& params);
+
+    // True if these options need another prepare() before they take effect
+    bool needsPrepare(const Options& options) const;
+
+    // Takes effect from the next process() call
+    void setParameters(const Parameters& params);
+
+    // input and output may share their channels. Blocks longer than
+    // maxBlockSize are rendered in pieces of that size. Returns how many wet
+    // samples the engine delivered; any shortfall is silent.
+    int process(const float* const* input, float* const* output, int numSamples);
+
+    // The same for a host mixing in double precision, after a prepare() with
+    // Options::doublePrecision. The dry signal keeps every bit of the input;
+    // the engines work in float, which RubberBand needs anyway.
+    int process(const double* const* input, double* const* output, int numSamples);
+
+    // Call from the audio thread before process() when the host renders
+    // faster than realtime. A bounce then runs at full quality without
+    // timing its blocks, and waits for the worker pool rather than leave a
+    // gap, so it comes out as a live run that kept up would have.
+    void setNonRealtime(bool isNonRealtime);
+
+    // Wet path latency, which the dry signal is held back by as well. It only
+    // changes with prepare() or a change of engine, never with the pitch.
+    // Safe to read from any thread.
+    int getLatencySamples() const;
+
+    // how long the output can go on after the input falls silent
+    double getTailLengthSeconds() const;
+
+    // Silent blocks in a row, on top of the tail, before the engines stop
+    // running. Call before prepare().
+    void setIdleHoldBlocks(int numBlocks);
+    bool isIdle() const;
+
+    // The QualityGovernor::Tier in use; safe to read from any thread.
+    int getQualityTier() const;
+
+    // memory held by the input history and the wet buffer
+    size_t getHistoryFootprintBytes() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl;
+
+    ChorusDSP(const ChorusDSP&) = delete;
+    ChorusDSP& operator=(const ChorusDSP&) = delete;
+};
@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    ChorusEngine.h
+
+    Common interface of the engines that turn the wet tap of the history ring
+    into the chorused voice.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "HistoryRing.h"
+
+//==============================================================================
+/**
+*/
+class ChorusEngine
+{
+public:
+    struct Parameters
+    {
+        float delaySamples = 0.0f;  // wet tap delay, may be fractional
+        float pitchCents = 0.0f;
+        float lfoFrequency = 1.0f;  // Hz
+        float lfoDepthCents = 0.0f;
+        int numVoices = 1;
+    };
+
+    // Furthest the pitch and its LFO reach together either side of zero,
+    // which bounds the latency of an engine whose latency follows the pitch
+    static constexpr float maxSweepCents = 125.0f;
+
+    virtual ~ChorusEngine() = default;
+
+    // numChannels is the number of history channels the engine will render,
+    // controlRate the exact rate of the control ticks, in Hz
+    virtual void prepare(double sampleRate, int maxBlockSize, int numChannels, double controlRate) = 0;
+    virtual void reset() = 0;
+
+    // Audio thread: the engine has stopped rendering, and is reset before it
+    // renders again. One that costs too much to reset there, such as a
+    // stretcher that has to be primed, hands the reset to another thread.
+    virtual void standby() { reset(); }
+
+    // Audio thread: false until the reset from standby() has finished. Only
+    // a ready engine is crossfaded in.
+    virtual bool isReady() { return true; }
+
+    // Called at every control tick with the parameters for the samples that
+    // follow it, so modulation advances at a rate independent of block size.
+    virtual void controlTick(const Parameters& params) = 0;
+
+    // Renders numSamples of the wet signal for every channel of the history
+    // into the matching dest channel, all channels sharing one modulation. A
+    // mono history may also be rendered into two dest channels, which pans the
+    // voices across the pair. The block must already have been written to the history.
+    // Returns how many samples the engine actually produced; any shortfall is
+    // left silent at the end of dest.
+    virtual int process(const HistoryRing& history, const Parameters& params,
+                        float* const* dest, int numDestChannels, int numSamples) = 0;
+
+    // Called once the whole host block has gone through process(), which
+    // may have been in several pieces, and the history has moved past it.
+    // For an engine that hands its work to other threads once per block.
+    virtual void endBlock(const HistoryRing& history, const Parameters& params) { juce::ignoreUnused(history, params); }
+
+    // Delay of the wet signal behind the wet tap. It is fixed at prepare()
+    // for the whole pitch range, so the host compensates for it once, and
+    // the dry tap is delayed by the same amount.
+    virtual int getLatencySamples() const = 0;
+
+    // How far behind the wet tap the engine reads the history, used to size it
+    virtual int getMaxLatencySamples() const { return getLatencySamples(); }
+};
@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    ControlScheduler.h
+
+    Splits audio blocks at control ticks that fall every fixed number of
+    samples, carrying the position between blocks. Modulation updated at the
+    ticks is then the same whatever block size the host uses.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+//==============================================================================
+/**
+*/
+class ControlScheduler
+{
+public:
+    static constexpr int defaultTicksPerSecond = 100;
+
+    void prepare(double sampleRate, int ticksPerSecond = defaultTicksPerSecond)
+    {
+        tickInterval = juce::jmax(1, juce::roundToInt(sampleRate / ticksPerSecond));
+        tickRate = sampleRate / tickInterval;
+        reset();
+    }
+
+    // the next block starts with a tick
+    void reset() { samplesUntilTick = 0; }
+
+    int getTickInterval() const { return tickInterval; }
+
+    // exact rate of the ticks, which the interval rounding moves slightly off the requested rate
+    double getTickRate() const { return tickRate; }
+
+    // Walks through a block of numSamples, calling onTick() at every tick and
+    // onChunk(startSample, numSamples) for each run of samples between ticks.
+    template <typename TickCallback, typename ChunkCallback>
+    void process(int numSamples, TickCallback&& onTick, ChunkCallback&& onChunk)
+    {
+        for (int start = 0; start < numSamples;) {
+            if (samplesUntilTick == 0) {
+                onTick();
+                samplesUntilTick = tickInterval;
+            }
+
+            int chunk = juce::jmin(numSamples - start, samplesUntilTick);
+            onChunk(start, chunk);
+
+            start += chunk;
+            samplesUntilTick -= chunk;
+        }
+    }
+
+private:
+    int tickInterval{ 441 };
+    double tickRate{ 100.0 };
+    int samplesUntilTick{ 0 };
+};
+
+//==============================================================================
+/**
+    Pitch ratio for an offset in cents, from a table shared by every instance
+    so that control ticks never have to call pow().
+*/
+struct CentsToRatioTable
+{
+    static constexpr double maxCents = 1200.0;
+
+    CentsToRatioTable()
+        : table([](double cents) { return std::pow(2.0, cents / 1200.0); }, -maxCents, maxCents, (size_t) (2 * maxCents) + 1)
+    {
+    }
+
+    // inputs beyond an octave either way are clipped
+    double operator()(double cents) const { return table.processSample(cents); }
+
+    juce::dsp::LookupTableTransform<double> table;
+};
@@ -0,0 +1,47 @@
+/*
+  ==============================================================================
+
+    DelayInterpolation.h
+
+    Fractional delay reads from a power-of-two ring: the interpolation types
+    and the margins every reader keeps. The voice bank's reads themselves
+    are kernels in the Kernels registry, built for each vector unit.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+//==============================================================================
+/**
+*/
+struct DelayInterpolation
+{
+    enum Type
+    {
+        linear = 0,
+        cubic,      // 4-point cubic Hermite
+        allpass     // first order allpass, flat magnitude but recursive
+    };
+
+    using Vec = juce::dsp::SIMDRegister<float>;
+    static constexpr int lanes = (int) Vec::SIMDNumElements;
+
+    // Margin the caller must keep between the write head and the shortest
+    // delay so that every tap of every kernel reads written samples.
+    static constexpr int minimumDelay = 2;
+
+    // Extra samples beyond the longest delay that a kernel may read.
+    static constexpr int maximumOvershoot = 2;
+
+    // Splits a delay into the ring index of its newer neighbour and the
+    // fraction of the way towards the older one.
+    static inline int splitDelay(int position, float delay, float& fraction) noexcept
+    {
+        int whole = (int) delay;
+        fraction = delay - (float) whole;
+        return position - whole;
+    }
+};
@@ -0,0 +1,88 @@
+/*
+  ==============================================================================
+
+    DelayLineEngine.cpp
+
+  ==============================================================================
+*/
+
+#include "DelayLineEngine.h"
+
+//==============================================================================
+void DelayLineEngine::prepare(double sampleRate, int maxBlockSize, int numChannels, double controlRate)
+{
+    // every channel shares the modulation, so the voice bank has no per-channel setup
+    juce::ignoreUnused(numChannels);
+    currentSampleRate = sampleRate;
+    maxModulationSamples = (float) (sampleRate * maxModulationMs / 1000.0);
+
+    // only a larger block size needs new buffers
+    if (maxBlockSize > maxSamples) {
+        baseDelays.allocate((size_t) maxBlockSize, true);
+        depths.allocate((size_t) maxBlockSize, true);
+        maxSamples = maxBlockSize;
+    }
+
+    // the processor smooths the parameters themselves, so these only have to
+    // ramp between control ticks
+    smoothedDelay.reset(sampleRate, 1.0 / controlRate);
+    smoothedDepth.reset(sampleRate, 1.0 / controlRate);
+
+    voices.prepare(sampleRate, maxBlockSize);
+    reset();
+}
+
+void DelayLineEngine::reset()
+{
+    smoothedDelay.setCurrentAndTargetValue(smoothedDelay.getTargetValue());
+    smoothedDepth.setCurrentAndTargetValue(smoothedDepth.getTargetValue());
+    voices.reset();
+}
+
+int DelayLineEngine::getRequiredHeadroom(double sampleRate)
+{
+    auto modulation = (int) std::ceil(sampleRate * maxModulationMs / 1000.0);
+    auto spread = (int) std::ceil(sampleRate * VoiceBank::delaySpreadMs / 1000.0);
+    return 2 * modulation + spread + DelayInterpolation::minimumDelay + DelayInterpolation::maximumOvershoot;
+}
+
+float DelayLineEngine::getModulationDepth(float peakCents, float frequency) const
+{
+    if (frequency <= 0.0f)
+        return 0.0f;
+
+    float peakDeviation = std::pow(2.0f, std::abs(peakCents) / 1200.0f) - 1.0f;
+    float depth = peakDeviation * (float) currentSampleRate / (juce::MathConstants<float>::twoPi * frequency);
+
+    return juce::jmin(depth, maxModulationSamples);
+}
+
+void DelayLineEngine::controlTick(const Parameters& params)
+{
+    // A delay line cannot hold a constant pitch offset, so the static pitch
+    // setting adds to the peak detune of the sweep.
+    float peakCents = std::abs(params.pitchCents) + params.lfoDepthCents;
+
+    smoothedDelay.setTargetValue(juce::jmax(0.0f, params.delaySamples));
+    smoothedDepth.setTargetValue(getModulationDepth(peakCents, params.lfoFrequency));
+    lfoFrequency = params.lfoFrequency;
+    voices.setNumVoices(params.numVoices);
+}
+
+int DelayLineEngine::process(const HistoryRing& history, const Parameters& params,
+                             float* const* dest, int numDestChannels, int numSamples)
+{
+    juce::ignoreUnused(params);
+    jassert(numSamples <= maxSamples);
+
+    auto* delayData = baseDelays.get();
+    auto* depthData = depths.get();
+
+    for (int i = 0; i < numSamples; ++i) {
+        delayData[i] = smoothedDelay.getNextValue();
+        depthData[i] = smoothedDepth.getNextValue();
+    }
+
+    voices.process(history, delayData, depthData, lfoFrequency, interpolation, dest, numDestChannels, numSamples);
+    return numSamples;
+}
@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    DelayLineEngine.h
+
+    Classic chorus: LFOs sweep fractional read positions through the history
+    ring, and the changing delays detune the wet voices. There is no latency
+    and only a few operations per sample and voice, so this is the low-CPU
+    alternative to the RubberBand engine.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ChorusEngine.h"
+#include "VoiceBank.h"
+
+//==============================================================================
+/**
+*/
+class DelayLineEngine  : public ChorusEngine
+{
+public:
+    DelayLineEngine() = default;
+
+    void prepare(double sampleRate, int maxBlockSize, int numChannels, double controlRate) override;
+    void reset() override;
+    void controlTick(const Parameters& params) override;
+    int process(const HistoryRing& history, const Parameters& params,
+                float* const* dest, int numDestChannels, int numSamples) override;
+    int getLatencySamples() const override { return 0; }
+
+    void setInterpolation(int type) { interpolation = type; }
+
+    // Samples the history needs beyond the longest wet tap delay to make room
+    // for the voice spread, the modulation sweep and the interpolation taps.
+    static int getRequiredHeadroom(double sampleRate);
+
+    static constexpr float maxModulationMs = 10.0f;
+
+private:
+    // A delay swinging by +/- depth samples at f Hz detunes by up to
+    // 2 pi f depth / sampleRate, so this is the depth for a peak detune.
+    float getModulationDepth(float peakCents, float frequency) const;
+
+    double currentSampleRate = 44100.0;
+    float maxModulationSamples = 0.0f;
+
+    // per-sample tap delay and sweep depth for the current block
+    juce::HeapBlock<float> baseDelays;
+    juce::HeapBlock<float> depths;
+    int maxSamples = 0;
+
+    juce::SmoothedValue<float> smoothedDelay;
+    juce::SmoothedValue<float> smoothedDepth;
+    float lfoFrequency = 0.0f;
+
+    VoiceBank voices;
+    int interpolation = DelayInterpolation::cubic;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayLineEngine)
+};
@@ -0,0 +1,140 @@
+/*
+  ==============================================================================
+
+    GranularEngine.cpp
+
+  ==============================================================================
+*/
+
+#include "GranularEngine.h"
+
+//==============================================================================
+void GranularEngine::prepare(double sampleRate, int maxBlockSize, int numChannels, double controlRate)
+{
+    // every channel shares the grains, so there is no per-channel state
+    juce::ignoreUnused(numChannels);
+    grainLength = (float) (sampleRate * grainMs / 1000.0);
+
+    // at the nominal pitch the first grain sits silent at the start of its
+    // window and the second plays alone, half a grain back
+    latencySamples = juce::roundToInt(0.5f * grainLength) + DelayInterpolation::minimumDelay;
+
+    if (maxBlockSize > maxSamples) {
+        for (int g = 0; g < 2; ++g) {
+            delays[g].allocate((size_t) maxBlockSize, true);
+            gains[g].allocate((size_t) maxBlockSize, true);
+        }
+
+        maxSamples = maxBlockSize;
+    }
+
+    for (int i = 0; i <= windowSize; ++i) {
+        float s = std::sin(juce::MathConstants<float>::pi * (float) i / (float) windowSize);
+        window[i] = s * s;
+    }
+
+    juce::dsp::ProcessSpec pitchLfoSpec = { controlRate, (juce::uint32) maxBlockSize, 1 };
+    pitchLfo.prepare(pitchLfoSpec);
+
+    if (! pitchLfo.isInitialised())
+        pitchLfo.initialise([](float x) {return std::sin(x); }, 128);
+
+    // the processor smooths the parameters themselves, so these only have to
+    // ramp between control ticks
+    smoothedDelay.reset(sampleRate, 1.0 / controlRate);
+    smoothedRatio.reset(sampleRate, 1.0 / controlRate);
+    smoothedRatio.setCurrentAndTargetValue(1.0f);
+
+    reset();
+}
+
+void GranularEngine::reset()
+{
+    pitchLfo.reset();
+    phase = 0.0f;
+    smoothedDelay.setCurrentAndTargetValue(smoothedDelay.getTargetValue());
+    smoothedRatio.setCurrentAndTargetValue(smoothedRatio.getTargetValue());
+}
+
+int GranularEngine::getRequiredHeadroom(double sampleRate)
+{
+    auto grain = (int) std::ceil(sampleRate * grainMs / 1000.0);
+    return grain + DelayInterpolation::minimumDelay + DelayInterpolation::maximumOvershoot;
+}
+
+float GranularEngine::getWindow(float grainPhase) const noexcept
+{
+    float position = grainPhase * (float) windowSize;
+    int index = juce::jlimit(0, windowSize - 1, (int) position);
+    float fraction = position - (float) index;
+    return window[index] + (window[index + 1] - window[index]) * fraction;
+}
+
+void GranularEngine::controlTick(const Parameters& params)
+{
+    pitchLfo.setFrequency(params.lfoFrequency);
+
+    auto pitchLfoOut = pitchLfo.processSample(0.0f);
+    float cents = params.pitchCents + pitchLfoOut * params.lfoDepthCents;
+
+    smoothedDelay.setTargetValue(juce::jmax(0.0f, params.delaySamples));
+    smoothedRatio.setTargetValue((float) (*centsToRatio)(cents));
+}
+
+int GranularEngine::process(const HistoryRing& history, const Parameters& params,
+                            float* const* dest, int numDestChannels, int numSamples)
+{
+    juce::ignoreUnused(params);
+    jassert(numSamples <= maxSamples);
+
+    // A delay falling by (ratio - 1) samples per sample plays the history
+    // back ratio times as fast. Each grain's delay covers one grain length
+    // before it wraps, at the point where its window is silent.
+    const float offset = (float) DelayInterpolation::minimumDelay;
+    const float inverseLength = 1.0f / grainLength;
+
+    for (int i = 0; i < numSamples; ++i) {
+        float base = smoothedDelay.getNextValue() + offset;
+        phase += (1.0f - smoothedRatio.getNextValue()) * inverseLength;
+        phase -= std::floor(phase);
+
+        float second = phase < 0.5f ? phase + 0.5f : phase - 0.5f;
+
+        delays[0][i] = base + phase * grainLength;
+        delays[1][i] = base + second * grainLength;
+        gains[0][i] = getWindow(phase);
+        gains[1][i] = 1.0f - gains[0][i];
+    }
+
+    const int oldest = history.getMaxDelay();
+    const int numChannels = juce::jmin(history.getNumChannels(), numDestChannels);
+
+    for (int c = 0; c < numChannels; ++c) {
+        // every tap lies in one contiguous window starting at the oldest sample
+        const float* x = history.getReadWindow(c, oldest);
+        float* out = dest[c];
+
+        for (int i = 0; i < numSamples; ++i) {
+            float sum = 0.0f;
+
+            for (int g = 0; g < 2; ++g) {
+                float f;
+                const float* tap = x + DelayInterpolation::splitDelay(oldest + i, delays[g][i], f);
+
+                // 4-point cubic Hermite, as in the kernels' readCubic
+                float c1 = (tap[-1] - tap[1]) * 0.5f;
+                float c2 = tap[1] - tap[0] * 2.5f + tap[-1] * 2.0f - tap[-2] * 0.5f;
+                float c3 = (tap[-2] - tap[1]) * 0.5f + (tap[0] - tap[-1]) * 1.5f;
+                sum += gains[g][i] * (((c3 * f + c2) * f + c1) * f + tap[0]);
+            }
+
+            out[i] = sum;
+        }
+    }
+
+    // a mono history rendered to a pair puts the one voice in the centre
+    for (int c = numChannels; c < numDestChannels; ++c)
+        juce::FloatVectorOperations::copy(dest[c], dest[0], numSamples);
+
+    return numSamples;
+}
@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    GranularEngine.h
+
+    Time-domain pitch shifter for small detunes. Two grains read the history
+    ring through delays that sweep at the rate the pitch ratio asks for, half
+    a grain apart, and each fades out under a raised-cosine window before its
+    delay jumps back. Its latency is half a grain, a few milliseconds, and it
+    costs a handful of operations per sample, so it stands in for RubberBand
+    where the ratio stays close to 1.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ChorusEngine.h"
+#include "ControlScheduler.h"
+#include "DelayInterpolation.h"
+
+//==============================================================================
+/**
+*/
+class GranularEngine  : public ChorusEngine
+{
+public:
+    GranularEngine() = default;
+
+    void prepare(double sampleRate, int maxBlockSize, int numChannels, double controlRate) override;
+    void reset() override;
+    void controlTick(const Parameters& params) override;
+    int process(const HistoryRing& history, const Parameters& params,
+                float* const* dest, int numDestChannels, int numSamples) override;
+    int getLatencySamples() const override { return latencySamples; }
+
+    // Samples the history needs beyond the longest wet tap delay for a whole
+    // grain and the interpolation taps.
+    static int getRequiredHeadroom(double sampleRate);
+
+    // Long enough that the grain rate stays below the pitch range of most
+    // material, short enough to keep the latency under 10 ms.
+    static constexpr float grainMs = 15.0f;
+
+private:
+    static constexpr int windowSize = 256;
+
+    // sin^2 over one grain, so two grains half a grain apart sum to 1
+    float getWindow(float phase) const noexcept;
+
+    float grainLength = 0.0f;
+    int latencySamples = 0;
+    float phase = 0.0f;     // position in the first grain, 0..1
+
+    // per-sample delays and gains of both grains for the current block
+    juce::HeapBlock<float> delays[2];
+    juce::HeapBlock<float> gains[2];
+    int maxSamples = 0;
+
+    float window[windowSize + 1];
+
+    juce::SmoothedValue<float> smoothedDelay;
+    juce::SmoothedValue<float> smoothedRatio;
+
+    // advances once per control tick, as in the RubberBand engine
+    juce::dsp::Oscillator<float> pitchLfo;
+    juce::SharedResourcePointer<CentsToRatioTable> centsToRatio;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GranularEngine)
+};
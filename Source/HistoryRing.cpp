@@ -0,0 +1,198 @@
+/*
+  ==============================================================================
+
+    HistoryRing.cpp
+
+  ==============================================================================
+*/
+
+#include "HistoryRing.h"
+#include "MixKernels.h"
+
+#if JUCE_LINUX
+ #include <sys/mman.h>
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+template <typename SampleType>
+BasicHistoryRing<SampleType>::~BasicHistoryRing()
+{
+    releaseStorage();
+}
+
+template <typename SampleType>
+void BasicHistoryRing<SampleType>::prepare(int newNumChannels, int maxDelaySamples, int maxBlockSize)
+{
+    jassert(newNumChannels > 0 && newNumChannels <= maxChannels && maxDelaySamples >= 0 && maxBlockSize > 0);
+
+    int newSize = juce::nextPowerOfTwo(maxDelaySamples + maxBlockSize);
+
+   #if JUCE_LINUX
+    // a mapping is made of whole pages, and the page size is a power of two too
+    newSize = juce::jmax(newSize, (int) ((size_t) sysconf(_SC_PAGESIZE) / sizeof(SampleType)));
+   #endif
+
+    maxDelay = maxDelaySamples;
+
+    // preparing again for the same layout keeps the storage, and the mapping with it
+    if (storage != nullptr && newNumChannels == numChannels && newSize == size) {
+        reset();
+        return;
+    }
+
+    releaseStorage();
+
+    numChannels = newNumChannels;
+    size = newSize;
+    mask = size - 1;
+
+    if (! mapMirrored()) {
+        fallback.allocate((size_t) numChannels * 2 * (size_t) size, true);
+        storage = fallback.get();
+    }
+
+    reset();
+}
+
+template <typename SampleType>
+bool BasicHistoryRing<SampleType>::mapMirrored()
+{
+   #if JUCE_LINUX
+    size_t channelBytes = (size_t) size * sizeof(SampleType);
+    size_t totalBytes = channelBytes * (size_t) numChannels;
+
+    int fd = memfd_create("HistoryRing", MFD_CLOEXEC);
+
+    if (fd < 0)
+        return false;
+
+    // reserve the whole address range first so the two views of a channel
+    // are guaranteed to be adjacent
+    void* reserved = ftruncate(fd, (off_t) totalBytes) == 0
+                   ? mmap(nullptr, 2 * totalBytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                   : MAP_FAILED;
+    bool mapped = reserved != MAP_FAILED;
+
+    for (int channel = 0; mapped && channel < numChannels; ++channel) {
+        auto* first = static_cast<char*>(reserved) + 2 * channelBytes * (size_t) channel;
+        auto offset = (off_t) (channelBytes * (size_t) channel);
+
+        mapped = mmap(first, channelBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, offset) != MAP_FAILED
+              && mmap(first + channelBytes, channelBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, offset) != MAP_FAILED;
+    }
+
+    // the mappings keep the memory alive on their own
+    close(fd);
+
+    if (! mapped) {
+        if (reserved != MAP_FAILED)
+            munmap(reserved, 2 * totalBytes);
+
+        return false;
+    }
+
+    storage = static_cast<SampleType*>(reserved);
+    mappedBytes = 2 * totalBytes;
+    mirrored = true;
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+template <typename SampleType>
+void BasicHistoryRing<SampleType>::releaseStorage()
+{
+   #if JUCE_LINUX
+    if (mirrored)
+        munmap(storage, mappedBytes);
+   #endif
+
+    fallback.free();
+    storage = nullptr;
+    mappedBytes = 0;
+    mirrored = false;
+}
+
+template <typename SampleType>
+void BasicHistoryRing<SampleType>::release()
+{
+    releaseStorage();
+    numChannels = size = mask = maxDelay = writePosition = 0;
+}
+
+template <typename SampleType>
+void BasicHistoryRing<SampleType>::reset()
+{
+    for (int channel = 0; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::clear(getChannel(channel), mirrored ? size : 2 * size);
+
+    writePosition = 0;
+}
+
+template <typename SampleType>
+void BasicHistoryRing<SampleType>::write(int channel, const float* source, int numSamples)
+{
+    writeSamples(channel, source, nullptr, {}, numSamples);
+}
+
+template <typename SampleType>
+void BasicHistoryRing<SampleType>::write(int channel, const double* source, int numSamples)
+{
+    writeSamples(channel, source, nullptr, {}, numSamples);
+}
+
+template <typename SampleType>
+void BasicHistoryRing<SampleType>::write(int channel, const float* source, const float* feedback, Kernels::Ramp gain, int numSamples)
+{
+    writeSamples(channel, source, feedback, gain, numSamples);
+}
+
+template <typename SampleType>
+void BasicHistoryRing<SampleType>::write(int channel, const double* source, const float* feedback, Kernels::Ramp gain, int numSamples)
+{
+    writeSamples(channel, source, feedback, gain, numSamples);
+}
+
+template <typename SampleType>
+template <typename SourceType>
+void BasicHistoryRing<SampleType>::writeSamples(int channel, const SourceType* source, const float* feedback,
+                                                Kernels::Ramp gain, int numSamples)
+{
+    jassert(numSamples <= size - maxDelay);
+
+    auto* data = getChannel(channel);
+    auto* block = data + writePosition;
+
+    if (feedback != nullptr)
+        MixKernels::copyWithFeedback(block, source, feedback, gain, numSamples);
+    else
+        MixKernels::copy(block, source, numSamples);
+
+    if (mirrored)
+        return;
+
+    // without the second mapping the other copy has to be written as well:
+    // whatever ran past the end of the first copy belongs at its start, and
+    // the rest at the same place in the second copy. Both are copied from
+    // the block just written, which already holds the feedback.
+    int first = juce::jmin(numSamples, size - writePosition);
+    MixKernels::copy(data + size + writePosition, block, first);
+    MixKernels::copy(data, block + first, numSamples - first);
+}
+
+template <typename SampleType>
+void BasicHistoryRing<SampleType>::advance(int numSamples)
+{
+    writePosition = (writePosition + numSamples) & mask;
+}
+
+template <typename SampleType>
+void BasicHistoryRing<SampleType>::read(int channel, int delaySamples, SampleType* dest, int numSamples) const
+{
+    juce::FloatVectorOperations::copy(dest, getReadWindow(channel, delaySamples), numSamples);
+}
+
+template class BasicHistoryRing<float>;
+template class BasicHistoryRing<double>;
@@ -0,0 +1,110 @@
+/*
+  ==============================================================================
+
+    HistoryRing.h
+
+    Power-of-two circular history of the plugin input. A single ring serves
+    every read tap (dry, wet, ...), each tap being a delay measured back from
+    the write head, i.e. the start of the block currently being processed.
+
+    Each channel is stored twice in a row, so any window of up to getSize()
+    samples is one contiguous run of memory whatever the write position. On
+    Linux the second copy is the same physical pages mapped again (memfd plus
+    mmap) and costs nothing to keep up to date; elsewhere, or if the mapping
+    fails, writes go to both copies.
+
+    The ring is generated for float and double samples from this one source.
+    The engines read a float ring; a host processing in double precision
+    keeps the dry signal in a double ring beside it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "Kernels.h"
+
+//==============================================================================
+/**
+*/
+template <typename SampleType>
+class BasicHistoryRing
+{
+public:
+    BasicHistoryRing() = default;
+    ~BasicHistoryRing();
+
+    // widest channel layout the plugin processes (7.1)
+    static constexpr int maxChannels = 8;
+
+    // Sizes the ring so that a block of maxBlockSize samples can be read back
+    // from up to maxDelaySamples in the past. The size is rounded up to a power
+    // of two so wrapping an index is a single mask.
+    void prepare(int numChannels, int maxDelaySamples, int maxBlockSize);
+    void reset();
+
+    // gives back the storage until the next prepare()
+    void release();
+
+    // Writes one block for a channel at the write head, converting from the
+    // other sample type if need be. Call advance() once the block has been
+    // written for every channel and all taps have been read.
+    void write(int channel, const float* source, int numSamples);
+    void write(int channel, const double* source, int numSamples);
+    void advance(int numSamples);
+
+    // Writes source plus gain times a float feedback signal, gliding the
+    // gain through the block
+    void write(int channel, const float* source, const float* feedback, Kernels::Ramp gain, int numSamples);
+    void write(int channel, const double* source, const float* feedback, Kernels::Ramp gain, int numSamples);
+
+    // Copies numSamples starting delaySamples before the write head into dest.
+    void read(int channel, int delaySamples, SampleType* dest, int numSamples) const;
+
+    // The sample delaySamples before the write head, followed contiguously by
+    // at least getSize() - 1 more, so taps can be consumed in place without
+    // wrapping. Everything from delaySamples back up to the write head plus the
+    // block being written is valid.
+    const SampleType* getReadWindow(int channel, int delaySamples) const
+    {
+        jassert(delaySamples >= 0 && delaySamples <= maxDelay);
+        return getChannel(channel) + ((writePosition - delaySamples) & mask);
+    }
+
+    int getNumChannels() const { return numChannels; }
+    int getSize() const { return size; }
+    int getMask() const { return mask; }
+    int getWritePosition() const { return writePosition; }
+    int getMaxDelay() const { return maxDelay; }
+    bool isMirrored() const { return mirrored; }
+
+    // memory actually committed, i.e. one copy per channel when mirrored
+    size_t getFootprintBytes() const { return (size_t) numChannels * (size_t) size * sizeof(SampleType) * (mirrored ? 1 : 2); }
+
+private:
+    SampleType* getChannel(int channel) const { return storage + (size_t) channel * 2 * (size_t) size; }
+
+    // feedback may be null
+    template <typename SourceType>
+    void writeSamples(int channel, const SourceType* source, const float* feedback, Kernels::Ramp gain, int numSamples);
+
+    bool mapMirrored();
+    void releaseStorage();
+
+    SampleType* storage = nullptr;          // numChannels runs of 2 * size samples
+    juce::HeapBlock<SampleType> fallback;   // backs storage when it is not mapped
+    size_t mappedBytes = 0;
+    bool mirrored = false;
+
+    int numChannels{ 0 };
+    int size{ 0 };
+    int mask{ 0 };
+    int maxDelay{ 0 };
+    int writePosition{ 0 }; // start of the block being processed
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BasicHistoryRing)
+};
+
+// the input history every engine reads
+using HistoryRing = BasicHistoryRing<float>;
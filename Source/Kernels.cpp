@@ -0,0 +1,163 @@
+/*
+  ==============================================================================
+
+    Kernels.cpp
+
+  ==============================================================================
+*/
+
+#include "Kernels.h"
+#include <atomic>
+
+#if CHORUS_KERNELS_X86
+ #if defined(_MSC_VER)
+  #include <intrin.h>
+ #else
+  #include <cpuid.h>
+ #endif
+#endif
+
+// one table per level, each in its own translation unit
+extern const Kernels baselineKernels;
+
+#if CHORUS_KERNELS_X86
+extern const Kernels avx2Kernels;
+extern const Kernels avx512Kernels;
+#endif
+
+namespace
+{
+   #if CHORUS_KERNELS_X86
+    void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+    {
+       #if defined(_MSC_VER)
+        int r[4];
+        __cpuidex(r, (int) leaf, (int) subleaf);
+
+        for (int i = 0; i < 4; ++i)
+            regs[i] = (unsigned int) r[i];
+       #else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+       #endif
+    }
+
+    // which register state the OS saves across context switches
+    unsigned long long readXcr0()
+    {
+       #if defined(_MSC_VER)
+        return _xgetbv(0);
+       #else
+        unsigned int eax, edx;
+        __asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+        return ((unsigned long long) edx << 32) | eax;
+       #endif
+    }
+   #endif
+
+    Kernels::Level detectLevel()
+    {
+       #if CHORUS_KERNELS_X86
+        unsigned int regs[4];
+        cpuid(0, 0, regs);
+        unsigned int maxLeaf = regs[0];
+
+        // The wider registers are only usable if the OS saves them, which
+        // XGETBV tells once OSXSAVE says it is there to ask
+        cpuid(1, 0, regs);
+        bool osxsave = (regs[2] & (1u << 27)) != 0;
+
+        if (! osxsave || maxLeaf < 7)
+            return Kernels::baseline;
+
+        auto xcr0 = readXcr0();
+        bool ymmSaved = (xcr0 & 0x06) == 0x06;  // SSE and AVX state
+        bool zmmSaved = (xcr0 & 0xe6) == 0xe6;  // and the opmask and upper ZMM state
+
+        cpuid(7, 0, regs);
+        bool hasAvx2 = (regs[1] & (1u << 5)) != 0;
+        bool hasAvx512F = (regs[1] & (1u << 16)) != 0;
+
+        if (hasAvx512F && zmmSaved)
+            return Kernels::avx512;
+
+        if (hasAvx2 && ymmSaved)
+            return Kernels::avx2;
+       #endif
+
+        return Kernels::baseline;
+    }
+
+    const Kernels* getTable(Kernels::Level level)
+    {
+        switch (level) {
+        case Kernels::baseline: return &baselineKernels;
+       #if CHORUS_KERNELS_X86
+        case Kernels::avx2:     return &avx2Kernels;
+        case Kernels::avx512:   return &avx512Kernels;
+       #endif
+        default:                return nullptr;
+        }
+    }
+
+    struct Registry
+    {
+        Registry() : supportedLevel(detectLevel())
+        {
+            active = getTable(supportedLevel);
+            activeLevel = supportedLevel;
+        }
+
+        const Kernels::Level supportedLevel;
+        std::atomic<const Kernels*> active{ nullptr };
+        std::atomic<int> activeLevel{ Kernels::baseline };
+    };
+
+    Registry& getRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    // picks the kernels while the library loads, not on the first audio callback
+    const Registry& startupRegistry = getRegistry();
+}
+
+//==============================================================================
+const Kernels& Kernels::get()
+{
+    return *getRegistry().active.load(std::memory_order_relaxed);
+}
+
+Kernels::Level Kernels::getSupportedLevel()
+{
+    return getRegistry().supportedLevel;
+}
+
+const Kernels* Kernels::getForLevel(Level level)
+{
+    return level <= getSupportedLevel() ? getTable(level) : nullptr;
+}
+
+bool Kernels::forceLevel(Level level)
+{
+    auto* kernels = getForLevel(level);
+
+    if (kernels == nullptr)
+        return false;
+
+    auto& registry = getRegistry();
+    registry.active.store(kernels, std::memory_order_relaxed);
+    registry.activeLevel.store(level, std::memory_order_relaxed);
+    return true;
+}
+
+Kernels::Level Kernels::getActiveLevel()
+{
+    return (Level) getRegistry().activeLevel.load(std::memory_order_relaxed);
+}
+
+const char* Kernels::getLevelName(Level level)
+{
+    const char* const names[] = { CHORUS_KERNELS_X86 ? "sse2" : "baseline", "avx2", "avx512" };
+    return level >= baseline && level < numLevels ? names[level] : "unknown";
+}
@@ -0,0 +1,100 @@
+/*
+  ==============================================================================
+
+    Kernels.h
+
+    Registry of the hot inner loops - the history write, the interpolated
+    delay reads of the voices, the voice sum and the output mix. Each is built
+    once per instruction set level from the same plain C++ source
+    (KernelsImpl.h), and the best level the CPU and OS support is picked
+    once at startup with cpuid. On x86-64 the baseline build is SSE2; other
+    architectures only have the baseline.
+
+    The kernels are compiled without contracting multiplies and adds into
+    fused ones, so every level produces the same bits and picking one never
+    changes the output.
+
+    This header is included by the per-level translation units, so it must
+    define nothing that the compiler could emit with wider instructions:
+    no inline functions and no JUCE headers.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #define CHORUS_KERNELS_X86 1
+#else
+ #define CHORUS_KERNELS_X86 0
+#endif
+
+//==============================================================================
+/**
+*/
+struct Kernels
+{
+    enum Level
+    {
+        baseline = 0,   // SSE2 on x86-64
+        avx2,
+        avx512,
+        numLevels
+    };
+
+    // a gain gliding through a block: sample i gets start + i * step
+    struct Ramp
+    {
+        float start;
+        float step;
+    };
+
+    // history write: dest = source, from float or double input
+    void (*copy)(float* dest, const float* source, int numSamples);
+    void (*convert)(float* dest, const double* source, int numSamples);
+
+    // history write with feedback: dest = source + gain * feedback
+    void (*writeFeedback)(float* dest, const float* source, const float* feedback, Ramp gain, int numSamples);
+    void (*writeFeedbackFromDouble)(float* dest, const double* source, const float* feedback, Ramp gain, int numSamples);
+
+    // Interpolated delay reads of numLanes voices at once, 1, 4 or 8, one lane
+    // per voice: delays and dest hold numLanes values per sample, with voice v
+    // of sample i at [i * numLanes + v], and dest[i * numLanes + v] is the tap
+    // delays[i * numLanes + v] samples before window[position + i]. The
+    // allpass read keeps each voice's recursion in state[v] from one block
+    // to the next.
+    void (*readLinear)(const float* window, int position, const float* delays, float* dest, int numLanes, int numSamples);
+    void (*readCubic)(const float* window, int position, const float* delays, float* dest, int numLanes, int numSamples);
+    void (*readAllpass)(const float* window, int position, const float* delays, float* dest, int numLanes, int numSamples,
+                        float* state);
+
+    // voice sum over the lanes of a voice read: dest[i] += gains[v] * voices[i * numLanes + v]
+    void (*sumVoices)(float* dest, const float* voices, const float* gains, int numLanes, int numSamples);
+
+    // Output mix in one pass: dest = dryGain * dry + wetGain * wet, with the
+    // output gain folded into both. The split versions put the dry signal
+    // on the left and the wet on the right.
+    void (*mix)(float* dest, const float* dry, const float* wet, Ramp dryGain, Ramp wetGain, int numSamples);
+    void (*mixToDouble)(double* dest, const double* dry, const float* wet, Ramp dryGain, Ramp wetGain, int numSamples);
+    void (*mixSplit)(float* left, float* right, const float* dry, const float* wet, Ramp dryGain, Ramp wetGain, int numSamples);
+    void (*mixSplitToDouble)(double* left, double* right, const double* dry, const float* wet,
+                             Ramp dryGain, Ramp wetGain, int numSamples);
+
+    // the kernels picked at startup, or forced with forceLevel()
+    static const Kernels& get();
+
+    // highest level this CPU and OS can run, as picked at startup
+    static Level getSupportedLevel();
+
+    // The kernels built for a level, or nullptr if that level was not built
+    // for this architecture or the CPU cannot run it
+    static const Kernels* getForLevel(Level level);
+
+    // For benchmarks and tests: runs everything at a lower level from now on.
+    // Returns false, changing nothing, for a level getForLevel() has no
+    // kernels for. Not to be called while audio is being processed.
+    static bool forceLevel(Level level);
+
+    static Level getActiveLevel();
+    static const char* getLevelName(Level level);
+};
@@ -0,0 +1,18 @@
+/*
+  ==============================================================================
+
+    KernelsAVX2.cpp
+
+    The kernels built for AVX2. The build gives this file -mavx2, or
+    /arch:AVX2 with MSVC; Kernels.cpp only picks it once cpuid says the CPU
+    and OS support AVX2.
+
+  ==============================================================================
+*/
+
+#include "Kernels.h"
+
+#if CHORUS_KERNELS_X86
+ #define CHORUS_KERNEL_TABLE avx2Kernels
+ #include "KernelsImpl.h"
+#endif
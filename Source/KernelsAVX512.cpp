@@ -0,0 +1,18 @@
+/*
+  ==============================================================================
+
+    KernelsAVX512.cpp
+
+    The kernels built for AVX-512F, with 512-bit vectors preferred. The
+    build gives this file -mavx512f, or /arch:AVX512 with MSVC; Kernels.cpp
+    only picks it once cpuid says the CPU and OS support AVX-512F.
+
+  ==============================================================================
+*/
+
+#include "Kernels.h"
+
+#if CHORUS_KERNELS_X86
+ #define CHORUS_KERNEL_TABLE avx512Kernels
+ #include "KernelsImpl.h"
+#endif
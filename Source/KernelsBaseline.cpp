@@ -0,0 +1,13 @@
+/*
+  ==============================================================================
+
+    KernelsBaseline.cpp
+
+    The kernels built with the project's own flags: SSE2 on x86-64, and the
+    only level on other architectures.
+
+  ==============================================================================
+*/
+
+#define CHORUS_KERNEL_TABLE baselineKernels
+#include "KernelsImpl.h"
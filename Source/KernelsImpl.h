@@ -0,0 +1,238 @@
+/*
+  ==============================================================================
+
+    KernelsImpl.h
+
+    The body of every kernel in the registry. Each KernelsXXX.cpp includes
+    this once, with CHORUS_KERNEL_TABLE naming its table, and is compiled
+    with its own instruction set flags; the compiler vectorises the loops
+    for that level. The functions have internal linkage, so the builds for
+    different levels never share a symbol.
+
+    Plain loops with nothing from JUCE or the standard library, which would
+    otherwise be emitted with this level's instructions and could be picked
+    by the linker for the rest of the program.
+
+  ==============================================================================
+*/
+
+#ifndef CHORUS_KERNEL_TABLE
+ #error "define CHORUS_KERNEL_TABLE before including KernelsImpl.h"
+#endif
+
+#include "Kernels.h"
+
+namespace
+{
+    void copy(float* __restrict dest, const float* __restrict source, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = source[i];
+    }
+
+    void convert(float* __restrict dest, const double* __restrict source, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = (float) source[i];
+    }
+
+    void writeFeedback(float* __restrict dest, const float* __restrict source, const float* __restrict feedback,
+                       Kernels::Ramp gain, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = source[i] + feedback[i] * (gain.start + gain.step * (float) i);
+    }
+
+    void writeFeedbackFromDouble(float* __restrict dest, const double* __restrict source, const float* __restrict feedback,
+                                 Kernels::Ramp gain, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = (float) source[i] + feedback[i] * (gain.start + gain.step * (float) i);
+    }
+
+    // The voice reads take every voice of the bank at once, with the taps of
+    // a sample laid out a lane per voice. One flat loop then runs across the
+    // voices and the samples together, and the compiler vectorises it with
+    // gathers. numLanes is fixed per instance, so k / numLanes is a shift;
+    // a single voice runs across the samples alone.
+    // Taps are window[j + 1] (the sample after the newer neighbour),
+    // window[j], window[j - 1] and window[j - 2].
+    template <int numLanes>
+    void readLinearLanes(const float* __restrict window, int position, const float* __restrict delays,
+                         float* __restrict dest, int numSamples)
+    {
+        for (int k = 0; k < numSamples * numLanes; ++k) {
+            int whole = (int) delays[k];
+            float fraction = delays[k] - (float) whole;
+            int j = position + k / numLanes - whole;
+
+            dest[k] = window[j] + (window[j - 1] - window[j]) * fraction;
+        }
+    }
+
+    template <int numLanes>
+    void readCubicLanes(const float* __restrict window, int position, const float* __restrict delays,
+                        float* __restrict dest, int numSamples)
+    {
+        for (int k = 0; k < numSamples * numLanes; ++k) {
+            int whole = (int) delays[k];
+            float fraction = delays[k] - (float) whole;
+            int j = position + k / numLanes - whole;
+
+            // Hermite coefficients, evaluated with Horner's scheme
+            float c1 = (window[j - 1] - window[j + 1]) * 0.5f;
+            float c2 = window[j + 1] - window[j] * 2.5f + window[j - 1] * 2.0f - window[j - 2] * 0.5f;
+            float c3 = (window[j - 2] - window[j + 1]) * 0.5f + (window[j] - window[j - 1]) * 1.5f;
+
+            dest[k] = ((c3 * fraction + c2) * fraction + c1) * fraction + window[j];
+        }
+    }
+
+    // Recursive in time, but each voice only depends on its own previous
+    // tap, numLanes taps back, so the recursion still vectorises across voices
+    template <int numLanes>
+    void readAllpassLanes(const float* __restrict window, int position, const float* __restrict delays,
+                          float* __restrict dest, int numSamples, float* __restrict state)
+    {
+        const int numTaps = numSamples * numLanes;
+
+        // keep the fraction in [0.1, 1.1), away from the pole on the unit circle at 0
+        auto isWrapped = [] (float fraction) { return fraction < 0.1f; };
+
+        // the coefficients go in dest first, in a loop of their own so the division vectorises
+        for (int k = 0; k < numTaps; ++k) {
+            int whole = (int) delays[k];
+            float fraction = delays[k] - (float) whole;
+            fraction += isWrapped(fraction) ? 1.0f : 0.0f;
+
+            dest[k] = (1.0f - fraction) / (1.0f + fraction);
+        }
+
+        auto newer = [=] (int k) {
+            int whole = (int) delays[k];
+            whole -= isWrapped(delays[k] - (float) whole) ? 1 : 0;
+            return position + k / numLanes - whole;
+        };
+
+        for (int k = 0; k < numLanes && k < numTaps; ++k) {
+            int j = newer(k);
+            dest[k] = window[j - 1] + dest[k] * (window[j] - state[k]);
+        }
+
+        for (int k = numLanes; k < numTaps; ++k) {
+            int j = newer(k);
+            dest[k] = window[j - 1] + dest[k] * (window[j] - dest[k - numLanes]);
+        }
+
+        if (numSamples > 0)
+            for (int v = 0; v < numLanes; ++v)
+                state[v] = dest[numTaps - numLanes + v];
+    }
+
+    // the voices are added in order, so the sum does not depend on the level
+    template <int numLanes>
+    void sumVoicesLanes(float* __restrict dest, const float* __restrict voices, const float* __restrict gains, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i) {
+            float sum = dest[i];
+
+            for (int v = 0; v < numLanes; ++v)
+                sum += voices[i * numLanes + v] * gains[v];
+
+            dest[i] = sum;
+        }
+    }
+
+    void readLinear(const float* window, int position, const float* delays, float* dest, int numLanes, int numSamples)
+    {
+        if (numLanes == 1)
+            readLinearLanes<1>(window, position, delays, dest, numSamples);
+        else if (numLanes == 4)
+            readLinearLanes<4>(window, position, delays, dest, numSamples);
+        else
+            readLinearLanes<8>(window, position, delays, dest, numSamples);
+    }
+
+    void readCubic(const float* window, int position, const float* delays, float* dest, int numLanes, int numSamples)
+    {
+        if (numLanes == 1)
+            readCubicLanes<1>(window, position, delays, dest, numSamples);
+        else if (numLanes == 4)
+            readCubicLanes<4>(window, position, delays, dest, numSamples);
+        else
+            readCubicLanes<8>(window, position, delays, dest, numSamples);
+    }
+
+    void readAllpass(const float* window, int position, const float* delays, float* dest, int numLanes, int numSamples,
+                     float* state)
+    {
+        if (numLanes == 1)
+            readAllpassLanes<1>(window, position, delays, dest, numSamples, state);
+        else if (numLanes == 4)
+            readAllpassLanes<4>(window, position, delays, dest, numSamples, state);
+        else
+            readAllpassLanes<8>(window, position, delays, dest, numSamples, state);
+    }
+
+    void sumVoices(float* dest, const float* voices, const float* gains, int numLanes, int numSamples)
+    {
+        if (numLanes == 1)
+            sumVoicesLanes<1>(dest, voices, gains, numSamples);
+        else if (numLanes == 4)
+            sumVoicesLanes<4>(dest, voices, gains, numSamples);
+        else
+            sumVoicesLanes<8>(dest, voices, gains, numSamples);
+    }
+
+    void mix(float* __restrict dest, const float* __restrict dry, const float* __restrict wet,
+             Kernels::Ramp dryGain, Kernels::Ramp wetGain, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = dry[i] * (dryGain.start + dryGain.step * (float) i)
+                    + wet[i] * (wetGain.start + wetGain.step * (float) i);
+    }
+
+    // the gains stay float, so a double host gets exactly what a float one would at unity
+    void mixToDouble(double* __restrict dest, const double* __restrict dry, const float* __restrict wet,
+                     Kernels::Ramp dryGain, Kernels::Ramp wetGain, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = dry[i] * (double) (dryGain.start + dryGain.step * (float) i)
+                    + (double) wet[i] * (double) (wetGain.start + wetGain.step * (float) i);
+    }
+
+    void mixSplit(float* __restrict left, float* __restrict right, const float* __restrict dry, const float* __restrict wet,
+                  Kernels::Ramp dryGain, Kernels::Ramp wetGain, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i) {
+            left[i] = dry[i] * (dryGain.start + dryGain.step * (float) i);
+            right[i] = wet[i] * (wetGain.start + wetGain.step * (float) i);
+        }
+    }
+
+    void mixSplitToDouble(double* __restrict left, double* __restrict right, const double* __restrict dry,
+                          const float* __restrict wet, Kernels::Ramp dryGain, Kernels::Ramp wetGain, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i) {
+            left[i] = dry[i] * (double) (dryGain.start + dryGain.step * (float) i);
+            right[i] = (double) wet[i] * (double) (wetGain.start + wetGain.step * (float) i);
+        }
+    }
+}
+
+extern const Kernels CHORUS_KERNEL_TABLE;
+
+const Kernels CHORUS_KERNEL_TABLE {
+    copy,
+    convert,
+    writeFeedback,
+    writeFeedbackFromDouble,
+    readLinear,
+    readCubic,
+    readAllpass,
+    sumVoices,
+    mix,
+    mixToDouble,
+    mixSplit,
+    mixSplitToDouble
+};
@@ -0,0 +1,109 @@
+/*
+  ==============================================================================
+
+    MixKernels.h
+
+    The copies and mixes that move audio between the host's buffers, the
+    history and the float wet signal, written once for float and double
+    samples. The float history writes and the output mix go through the
+    Kernels registry, built for the widest vector unit the CPU has; the
+    double history uses JUCE's vector operations, or a plain loop that the
+    compiler vectorises together with the conversion.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "Kernels.h"
+
+//==============================================================================
+/**
+*/
+struct MixKernels
+{
+    template <typename DestType, typename SourceType>
+    static inline void copy(DestType* dest, const SourceType* source, int numSamples) noexcept
+    {
+        if constexpr (std::is_same<DestType, float>::value && std::is_same<SourceType, float>::value) {
+            Kernels::get().copy(dest, source, numSamples);
+        }
+        else if constexpr (std::is_same<DestType, float>::value && std::is_same<SourceType, double>::value) {
+            Kernels::get().convert(dest, source, numSamples);
+        }
+        else if constexpr (std::is_same<DestType, SourceType>::value) {
+            juce::FloatVectorOperations::copy(dest, source, numSamples);
+        }
+        else {
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = (DestType) source[i];
+        }
+    }
+
+    // dest = source + gain * feedback
+    template <typename DestType, typename SourceType>
+    static inline void copyWithFeedback(DestType* dest, const SourceType* source, const float* feedback,
+                                        Kernels::Ramp gain, int numSamples) noexcept
+    {
+        if constexpr (std::is_same<DestType, float>::value && std::is_same<SourceType, float>::value) {
+            Kernels::get().writeFeedback(dest, source, feedback, gain, numSamples);
+        }
+        else if constexpr (std::is_same<DestType, float>::value && std::is_same<SourceType, double>::value) {
+            Kernels::get().writeFeedbackFromDouble(dest, source, feedback, gain, numSamples);
+        }
+        else {
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = (DestType) source[i] + (DestType) (feedback[i] * (gain.start + gain.step * (float) i));
+        }
+    }
+
+    // dest = dryGain * dry + wetGain * wet
+    template <typename SampleType>
+    static inline void mix(SampleType* dest, const SampleType* dry, const float* wet,
+                           Kernels::Ramp dryGain, Kernels::Ramp wetGain, int numSamples) noexcept
+    {
+        if constexpr (std::is_same<SampleType, float>::value)
+            Kernels::get().mix(dest, dry, wet, dryGain, wetGain, numSamples);
+        else
+            Kernels::get().mixToDouble(dest, dry, wet, dryGain, wetGain, numSamples);
+    }
+
+    // A dry tap gliding to a new delay: dest[i] is the sample delay.start +
+    // i * delay.step before window[position + i], linearly interpolated. A
+    // plain loop, as it only runs while the delay moves.
+    template <typename SampleType>
+    static inline void readGliding(SampleType* dest, const SampleType* window, int position,
+                                   Kernels::Ramp delay, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i) {
+            float delaySamples = delay.start + delay.step * (float) i;
+            int whole = (int) delaySamples;
+            auto fraction = (SampleType) (delaySamples - (float) whole);
+            const SampleType* x = window + position + i - whole;
+
+            dest[i] = x[0] + (x[-1] - x[0]) * fraction;
+        }
+    }
+
+    // dest = from + gains[i] * (to - from), dest may be from. A plain loop,
+    // as it only runs through a change of engine.
+    template <typename SampleType>
+    static inline void crossfade(SampleType* dest, const SampleType* from, const SampleType* to,
+                                 const float* gains, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = from[i] + (SampleType) gains[i] * (to[i] - from[i]);
+    }
+
+    // left = dryGain * dry, right = wetGain * wet
+    template <typename SampleType>
+    static inline void mixSplit(SampleType* left, SampleType* right, const SampleType* dry, const float* wet,
+                                Kernels::Ramp dryGain, Kernels::Ramp wetGain, int numSamples) noexcept
+    {
+        if constexpr (std::is_same<SampleType, float>::value)
+            Kernels::get().mixSplit(left, right, dry, wet, dryGain, wetGain, numSamples);
+        else
+            Kernels::get().mixSplitToDouble(left, right, dry, wet, dryGain, wetGain, numSamples);
+    }
+};
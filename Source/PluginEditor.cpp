@@ -8,58 +8,145 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "QualityGovernor.h"
 
 //==============================================================================
 ChorusPluginAudioProcessorEditor::ChorusPluginAudioProcessorEditor (ChorusPluginAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), telemetryReader (p.getTelemetry())
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (400, 220);
+    setSize (400, 511);
 
     addAndMakeVisible(delaySlider);
-    delaySlider.setRange(-200, 200, 1);
     delaySlider.setTextValueSuffix(" ms");
-    delaySlider.addListener(this);
-    delaySlider.setValue(0);
 
     addAndMakeVisible(delayLabel);
     delayLabel.setText("Delay",juce::NotificationType::sendNotification);
     delayLabel.attachToComponent(&delaySlider, true);
 
     addAndMakeVisible(pitchSlider);
-    pitchSlider.setRange(-25, 25, 1);
     pitchSlider.setTextValueSuffix(" cents");
-    pitchSlider.addListener(this);
-    pitchSlider.setValue(5);
 
     addAndMakeVisible(pitchLabel);
     pitchLabel.setText("Pitch", juce::NotificationType::sendNotification);
     pitchLabel.attachToComponent(&pitchSlider, true);
 
     addAndMakeVisible(pitchLfoFreqSlider);
-    pitchLfoFreqSlider.setRange(0, 10, 0.1);
     pitchLfoFreqSlider.setTextValueSuffix(" Hz");
-    pitchLfoFreqSlider.addListener(this);
-    pitchLfoFreqSlider.setValue(1);
 
     addAndMakeVisible(pitchLfoFreqLabel);
     pitchLfoFreqLabel.setText("Pitch LFO Frequency", juce::NotificationType::sendNotification);
     pitchLfoFreqLabel.attachToComponent(&pitchLfoFreqSlider, true);
 
     addAndMakeVisible(pitchLfoDepthSlider);
-    pitchLfoDepthSlider.setRange(0, 100, 1);
     pitchLfoDepthSlider.setTextValueSuffix(" cents");
-    pitchLfoDepthSlider.addListener(this);
-    pitchLfoDepthSlider.setValue(10);
 
     addAndMakeVisible(pitchLfoDepthLabel);
     pitchLfoDepthLabel.setText("Pitch LFO Depth", juce::NotificationType::sendNotification);
     pitchLfoDepthLabel.attachToComponent(&pitchLfoDepthSlider, true);
+
+    addAndMakeVisible(voicesSlider);
+
+    addAndMakeVisible(voicesLabel);
+    voicesLabel.setText("Voices", juce::NotificationType::sendNotification);
+    voicesLabel.attachToComponent(&voicesSlider, true);
+
+    addAndMakeVisible(mixSlider);
+    mixSlider.setTextValueSuffix(" %");
+
+    addAndMakeVisible(mixLabel);
+    mixLabel.setText("Mix", juce::NotificationType::sendNotification);
+    mixLabel.attachToComponent(&mixSlider, true);
+
+    addAndMakeVisible(feedbackSlider);
+    feedbackSlider.setTextValueSuffix(" %");
+
+    addAndMakeVisible(feedbackLabel);
+    feedbackLabel.setText("Feedback", juce::NotificationType::sendNotification);
+    feedbackLabel.attachToComponent(&feedbackSlider, true);
+
+    addAndMakeVisible(outputGainSlider);
+    outputGainSlider.setTextValueSuffix(" dB");
+
+    addAndMakeVisible(outputGainLabel);
+    outputGainLabel.setText("Output", juce::NotificationType::sendNotification);
+    outputGainLabel.attachToComponent(&outputGainSlider, true);
+
+    addAndMakeVisible(engineBox);
+    engineBox.addItem("Pitch shift (RubberBand)", ChorusPluginAudioProcessor::pitchShiftEngine + 1);
+    engineBox.addItem("Delay line (low CPU)", ChorusPluginAudioProcessor::delayLineEngine + 1);
+    engineBox.addItem("Granular (low latency)", ChorusPluginAudioProcessor::granularEngine + 1);
+
+    addAndMakeVisible(engineLabel);
+    engineLabel.setText("Engine", juce::NotificationType::sendNotification);
+    engineLabel.attachToComponent(&engineBox, true);
+
+    addAndMakeVisible(interpolationBox);
+    interpolationBox.addItem("Linear", ChorusDSP::linearInterpolation + 1);
+    interpolationBox.addItem("Cubic", ChorusDSP::cubicInterpolation + 1);
+    interpolationBox.addItem("Allpass", ChorusDSP::allpassInterpolation + 1);
+
+    addAndMakeVisible(interpolationLabel);
+    interpolationLabel.setText("Interpolation", juce::NotificationType::sendNotification);
+    interpolationLabel.attachToComponent(&interpolationBox, true);
+
+    addAndMakeVisible(lowLatencyButton);
+    addAndMakeVisible(workerPoolButton);
+    addAndMakeVisible(adaptiveQualityButton);
+
+    addAndMakeVisible(meterLabel);
+    meterLabel.setFont(juce::Font(12.0f));
+    meterLabel.setJustificationType(juce::Justification::centredLeft);
+
+    addAndMakeVisible(qualityLabel);
+    qualityLabel.setFont(juce::Font(12.0f));
+    qualityLabel.setJustificationType(juce::Justification::centredLeft);
+
+    auto& parameters = audioProcessor.getValueTreeState();
+    delayAttachment = std::make_unique<SliderAttachment>(parameters, "delay", delaySlider);
+    pitchAttachment = std::make_unique<SliderAttachment>(parameters, "pitch", pitchSlider);
+    pitchLfoFreqAttachment = std::make_unique<SliderAttachment>(parameters, "lfoFrequency", pitchLfoFreqSlider);
+    pitchLfoDepthAttachment = std::make_unique<SliderAttachment>(parameters, "lfoDepth", pitchLfoDepthSlider);
+    voicesAttachment = std::make_unique<SliderAttachment>(parameters, "voices", voicesSlider);
+    mixAttachment = std::make_unique<SliderAttachment>(parameters, "mix", mixSlider);
+    feedbackAttachment = std::make_unique<SliderAttachment>(parameters, "feedback", feedbackSlider);
+    outputGainAttachment = std::make_unique<SliderAttachment>(parameters, "outputGain", outputGainSlider);
+    engineAttachment = std::make_unique<ComboBoxAttachment>(parameters, "engine", engineBox);
+    interpolationAttachment = std::make_unique<ComboBoxAttachment>(parameters, "interpolation", interpolationBox);
+    lowLatencyAttachment = std::make_unique<ButtonAttachment>(parameters, "lowLatency", lowLatencyButton);
+    workerPoolAttachment = std::make_unique<ButtonAttachment>(parameters, "workerPool", workerPoolButton);
+    adaptiveQualityAttachment = std::make_unique<ButtonAttachment>(parameters, "adaptiveQuality", adaptiveQualityButton);
+
+    timerCallback();
+    startTimerHz(10);
 }
 
 ChorusPluginAudioProcessorEditor::~ChorusPluginAudioProcessorEditor()
 {
+    stopTimer();
+}
+
+void ChorusPluginAudioProcessorEditor::timerCallback()
+{
+    telemetryReader.update();
+
+    double sampleRate = audioProcessor.getSampleRate();
+    double latencyMs = sampleRate > 0.0 ? telemetryReader.getLatencySamples() * 1000.0 / sampleRate : 0.0;
+
+    meterLabel.setText(juce::String::formatted("CPU %3d%% (peak %3d%%)%s   deadline misses %lld   dropped %lld   latency %.1f ms",
+                                               juce::roundToInt(100.0f * telemetryReader.getLoad()),
+                                               juce::roundToInt(100.0f * telemetryReader.getPeakLoad()),
+                                               telemetryReader.isIdle() ? " idle" : "",
+                                               (long long) telemetryReader.getDeadlineMisses(),
+                                               (long long) telemetryReader.getDroppedSamples(),
+                                               latencyMs),
+                       juce::dontSendNotification);
+
+    int tier = telemetryReader.getQualityTier();
+    qualityLabel.setText(tier == QualityGovernor::full ? juce::String()
+                                                       : juce::String("Quality reduced: ") + QualityGovernor::getTierName(tier),
+                         juce::dontSendNotification);
 }
 
 //==============================================================================
@@ -83,33 +170,15 @@ void ChorusPluginAudioProcessorEditor::resized()
     pitchSlider.setBounds(75,62, 300, 50);
     pitchLfoFreqSlider.setBounds(75,99,300,50);
     pitchLfoDepthSlider.setBounds(75,136,300,50);
+    voicesSlider.setBounds(75,173,300,50);
+    mixSlider.setBounds(75,210,300,50);
+    feedbackSlider.setBounds(75,247,300,50);
+    outputGainSlider.setBounds(75,284,300,50);
+    engineBox.setBounds(175,336,200,24);
+    interpolationBox.setBounds(175,373,200,24);
+    lowLatencyButton.setBounds(175,410,100,24);
+    workerPoolButton.setBounds(275,410,115,24);
+    adaptiveQualityButton.setBounds(175,437,200,24);
+    meterLabel.setBounds(20,466,360,20);
+    qualityLabel.setBounds(20,484,360,20);
 }
-
-void ChorusPluginAudioProcessorEditor::sliderValueChanged(juce::Slider* slider)
-{
-    if (slider == &delaySlider) {
-        double delayValue = delaySlider.getValue();
-        //DBG(delayValue);
-        if (delayValue <= 0) {
-            audioProcessor.dryOffset = -1 * delayValue;
-            audioProcessor.delayOffset = 0;
-        }
-        else {
-            audioProcessor.dryOffset = 0;
-            audioProcessor.delayOffset = delayValue;
-        }
-    }
-    else if (slider == &pitchSlider) {
-        double pitchValue = pitchSlider.getValue();
-        //DBG(pitchValue);
-        audioProcessor.pitchCents = pitchValue;
-    }
-    else if (slider == &pitchLfoFreqSlider) {
-        float pitchLfoFreqValue = pitchLfoFreqSlider.getValue();
-        audioProcessor.pitchLfoFreq = pitchLfoFreqValue;
-    }
-    else if (slider == &pitchLfoDepthSlider) {
-        float pitchLfoDepthValue = pitchLfoDepthSlider.getValue();
-        audioProcessor.pitchLfoDepth = pitchLfoDepthValue;
-    }
-}
\ No newline at end of file
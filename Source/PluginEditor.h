@@ -14,7 +14,8 @@
 //==============================================================================
 /**
 */
-class ChorusPluginAudioProcessorEditor  : public juce::AudioProcessorEditor, public juce::Slider::Listener
+class ChorusPluginAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                          private juce::Timer
 {
 public:
     ChorusPluginAudioProcessorEditor (ChorusPluginAudioProcessor&);
@@ -23,9 +24,11 @@ public:
     //==============================================================================
     void paint (juce::Graphics&) override;
     void resized() override;
-    void sliderValueChanged(juce::Slider* slider) override;
 
 private:
+    // refreshes the meter from the processor's telemetry
+    void timerCallback() override;
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     ChorusPluginAudioProcessor& audioProcessor;
@@ -38,6 +41,46 @@ private:
     juce::Label pitchLfoFreqLabel;
     juce::Slider pitchLfoDepthSlider;
     juce::Label pitchLfoDepthLabel;
+    juce::Slider voicesSlider;
+    juce::Label voicesLabel;
+    juce::Slider mixSlider;
+    juce::Label mixLabel;
+    juce::Slider feedbackSlider;
+    juce::Label feedbackLabel;
+    juce::Slider outputGainSlider;
+    juce::Label outputGainLabel;
+    juce::ComboBox engineBox;
+    juce::Label engineLabel;
+    juce::ComboBox interpolationBox;
+    juce::Label interpolationLabel;
+    juce::ToggleButton lowLatencyButton{ "Low latency" };
+    juce::ToggleButton workerPoolButton{ "Worker threads" };
+    juce::ToggleButton adaptiveQualityButton{ "Adaptive quality" };
+    juce::Label meterLabel;
+    juce::Label qualityLabel;   // the governor's tier, when it has stepped down
+
+    // the processor only records telemetry while the editor is open
+    Telemetry::Reader telemetryReader;
+
+    // attachments go last so they are destroyed before the controls they drive.
+    // They are made once the combo boxes have their items.
+    using SliderAttachment = juce::AudioProcessorValueTreeState::SliderAttachment;
+    using ComboBoxAttachment = juce::AudioProcessorValueTreeState::ComboBoxAttachment;
+    using ButtonAttachment = juce::AudioProcessorValueTreeState::ButtonAttachment;
+
+    std::unique_ptr<SliderAttachment> delayAttachment;
+    std::unique_ptr<SliderAttachment> pitchAttachment;
+    std::unique_ptr<SliderAttachment> pitchLfoFreqAttachment;
+    std::unique_ptr<SliderAttachment> pitchLfoDepthAttachment;
+    std::unique_ptr<SliderAttachment> voicesAttachment;
+    std::unique_ptr<SliderAttachment> mixAttachment;
+    std::unique_ptr<SliderAttachment> feedbackAttachment;
+    std::unique_ptr<SliderAttachment> outputGainAttachment;
+    std::unique_ptr<ComboBoxAttachment> engineAttachment;
+    std::unique_ptr<ComboBoxAttachment> interpolationAttachment;
+    std::unique_ptr<ButtonAttachment> lowLatencyAttachment;
+    std::unique_ptr<ButtonAttachment> workerPoolAttachment;
+    std::unique_ptr<ButtonAttachment> adaptiveQualityAttachment;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChorusPluginAudioProcessorEditor)
 };
@@ -8,6 +8,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "RealtimeGuard.h"
 
 //==============================================================================
 ChorusPluginAudioProcessor::ChorusPluginAudioProcessor()
@@ -15,17 +16,92 @@ ChorusPluginAudioProcessor::ChorusPluginAudioProcessor()
      : AudioProcessor (BusesProperties()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
-                       .withInput  ("Input",  juce::AudioChannelSet::mono(), true)
+                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
                        )
 #endif
+     , parameters (*this, nullptr, "ChorusPlugin", createParameterLayout())
 {
+    delayParameter = parameters.getRawParameterValue("delay");
+    pitchParameter = parameters.getRawParameterValue("pitch");
+    lfoFrequencyParameter = parameters.getRawParameterValue("lfoFrequency");
+    lfoDepthParameter = parameters.getRawParameterValue("lfoDepth");
+    voicesParameter = parameters.getRawParameterValue("voices");
+    engineParameter = parameters.getRawParameterValue("engine");
+    interpolationParameter = parameters.getRawParameterValue("interpolation");
+    mixParameter = parameters.getRawParameterValue("mix");
+    feedbackParameter = parameters.getRawParameterValue("feedback");
+    outputGainParameter = parameters.getRawParameterValue("outputGain");
+    lowLatencyParameter = parameters.getRawParameterValue("lowLatency");
+    workerPoolParameter = parameters.getRawParameterValue("workerPool");
+    adaptiveQualityParameter = parameters.getRawParameterValue("adaptiveQuality");
+
+    parameters.addParameterListener("lowLatency", this);
+    parameters.addParameterListener("workerPool", this);
+    parameters.addParameterListener("adaptiveQuality", this);
+
+    // option changes and latency moves are picked up here on the message thread
+    startTimerHz(10);
 }
 
 ChorusPluginAudioProcessor::~ChorusPluginAudioProcessor()
 {
+    parameters.removeParameterListener("lowLatency", this);
+    parameters.removeParameterListener("workerPool", this);
+    parameters.removeParameterListener("adaptiveQuality", this);
+    stopTimer();
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout ChorusPluginAudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>("delay", "Delay",
+                   juce::NormalisableRange<float>((float) -maxDelayMs, (float) maxDelayMs, 0.1f), 0.0f, "ms"),
+               std::make_unique<juce::AudioParameterFloat>("pitch", "Pitch",
+                   juce::NormalisableRange<float>(-ChorusDSP::maxPitchCents, ChorusDSP::maxPitchCents, 1.0f), 5.0f, "cents"),
+               std::make_unique<juce::AudioParameterFloat>("lfoFrequency", "Pitch LFO Frequency",
+                   juce::NormalisableRange<float>(0.0f, 10.0f, 0.1f), 1.0f, "Hz"),
+               std::make_unique<juce::AudioParameterFloat>("lfoDepth", "Pitch LFO Depth",
+                   juce::NormalisableRange<float>(0.0f, ChorusDSP::maxLfoDepthCents, 1.0f), 10.0f, "cents"),
+               std::make_unique<juce::AudioParameterInt>("voices", "Voices", 1, ChorusDSP::maxVoices, 1),
+               std::make_unique<juce::AudioParameterChoice>("engine", "Engine",
+                   juce::StringArray{ "Pitch shift (RubberBand)", "Delay line (low CPU)", "Granular (low latency)" }, pitchShiftEngine),
+               std::make_unique<juce::AudioParameterChoice>("interpolation", "Interpolation",
+                   juce::StringArray{ "Linear", "Cubic", "Allpass" }, ChorusDSP::cubicInterpolation),
+               std::make_unique<juce::AudioParameterFloat>("mix", "Mix",
+                   juce::NormalisableRange<float>(0.0f, 100.0f, 1.0f), 50.0f, "%"),
+               std::make_unique<juce::AudioParameterFloat>("feedback", "Feedback",
+                   juce::NormalisableRange<float>(0.0f, 100.0f * ChorusDSP::maxFeedback, 1.0f), 0.0f, "%"),
+               std::make_unique<juce::AudioParameterFloat>("outputGain", "Output Gain",
+                   juce::NormalisableRange<float>(-30.0f, 12.0f, 0.1f), 0.0f, "dB"),
+               std::make_unique<juce::AudioParameterBool>("lowLatency", "Low Latency", false),
+               std::make_unique<juce::AudioParameterBool>("workerPool", "Worker Threads", false),
+               std::make_unique<juce::AudioParameterBool>("adaptiveQuality", "Adaptive Quality", false));
+
+    return layout;
+}
+
+void ChorusPluginAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    // may arrive on the audio thread, so the rebuild is left to the timer
+    juce::ignoreUnused(parameterID, newValue);
+    optionsChanged = true;
+}
+
+void ChorusPluginAudioProcessor::timerCallback()
+{
+    if (optionsChanged.exchange(false))
+        updateEngineOptions();
+
+    // A change of engine moves the latency, which the DSP publishes as an
+    // atomic. Hosts may restart processing to compensate, so they hear of
+    // it from here rather than from the audio thread, and not at all
+    // part-way through a bounce.
+    if (! isNonRealtime())
+        updateLatency();
 }
 
 //==============================================================================
@@ -63,7 +139,7 @@ bool ChorusPluginAudioProcessor::isMidiEffect() const
 
 double ChorusPluginAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return chorus.getTailLengthSeconds();
 }
 
 int ChorusPluginAudioProcessor::getNumPrograms()
@@ -93,26 +169,10 @@ void ChorusPluginAudioProcessor::changeProgramName (int index, const juce::Strin
 //==============================================================================
 void ChorusPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    delayBuffer.setSize(1,sampleRate*samplesPerBlock);
-    dryBuffer.setSize(1,sampleRate*samplesPerBlock);
-    pitchShiftBuffer.setSize(1,sampleRate*samplesPerBlock);
-
-    // initialize LFO objects
-    juce::dsp::ProcessSpec pitchLfoSpec = { sampleRate / lfoUpdateRate, samplesPerBlock, 1 };
-    pitchLfo.prepare(pitchLfoSpec);
-    pitchLfo.initialise([](float x) {return std::sin(x); }, 128);
-
-    // create rubberbandstretcher object
-    // Uses hard coded number of output channels to be 1 as we only affect one buffer
-    rbs = std::make_unique<RubberBand::RubberBandStretcher>(sampleRate, 1, rbsOptions, rbsDefaultTimeRatio, rbsDefaultPitchScale);
-    // rbs = std::make_unique<RubberBand::RubberBandStretcher>(sampleRate, 1);
-
-    // clear internal buffers for rbs object
-    rbs->reset();
-
-    rbDelay = rbs->getLatency();
-    DBG(rbDelay);
-    DBG(rbs->getPitchScale());
+    chorus.prepare(sampleRate, samplesPerBlock, getTotalNumInputChannels(), getTotalNumOutputChannels(),
+                   getChorusOptions(), getChorusParameters());
+
+    setLatencySamples(chorus.getLatencySamples());
 }
 
 void ChorusPluginAudioProcessor::releaseResources()
@@ -128,35 +188,91 @@ bool ChorusPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Every channel is chorused in place, so any layout up to 7.1 works as
+    // long as input and output match. Mono in, stereo out is kept for the
+    // original behaviour of dry on the left and wet on the right.
+    auto input = layouts.getMainInputChannelSet();
+    auto output = layouts.getMainOutputChannelSet();
+
+    if (output.isDisabled() || output.size() > ChorusDSP::maxChannels)
         return false;
 
-    return true;
+    if (input == juce::AudioChannelSet::mono() && output == juce::AudioChannelSet::stereo())
+        return true;
+
+    return input == output;
   #endif
 }
 #endif
 
-int ChorusPluginAudioProcessor::getLatency() {
-    return 4000;
-    if (rbs->getPitchScale() == 1.0) {
-        return 2115;
-    }
-    else if (rbs->getPitchScale() > 1.0) {
-        return 3900;
-    }
-    else {
-        return 2115;
-    }
+ChorusDSP::Parameters ChorusPluginAudioProcessor::getChorusParameters() const
+{
+    ChorusDSP::Parameters params;
+    params.delayMs = delayParameter->load();
+    params.pitchCents = pitchParameter->load();
+    params.lfoFrequency = lfoFrequencyParameter->load();
+    params.lfoDepthCents = lfoDepthParameter->load();
+    params.numVoices = (int) voicesParameter->load();
+    params.engine = (int) engineParameter->load();
+    params.interpolation = (int) interpolationParameter->load();
+    params.mix = mixParameter->load() / 100.0f;
+    params.feedback = feedbackParameter->load() / 100.0f;
+    params.outputGainDb = outputGainParameter->load();
+    return params;
+}
+
+ChorusDSP::Options ChorusPluginAudioProcessor::getChorusOptions() const
+{
+    ChorusDSP::Options options;
+    options.lowLatency = lowLatencyParameter->load() > 0.5f;
+    options.workerPool = workerPoolParameter->load() > 0.5f;
+    options.adaptiveQuality = adaptiveQualityParameter->load() > 0.5f;
+    options.doublePrecision = isUsingDoublePrecision();
+    return options;
+}
+
+void ChorusPluginAudioProcessor::updateEngineOptions()
+{
+    if (! chorus.needsPrepare(getChorusOptions()))
+        return;
+
+    // the stretcher is rebuilt, or the history resized, outside the audio callback
+    suspendProcessing(true);
+
+    if (getSampleRate() > 0.0 && getBlockSize() > 0)
+        prepareToPlay(getSampleRate(), getBlockSize());
+
+    suspendProcessing(false);
+}
+
+void ChorusPluginAudioProcessor::updateLatency()
+{
+    int latency = chorus.getLatencySamples();
+
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
 }
 
 void ChorusPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples(buffer);
+}
+
+void ChorusPluginAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples(buffer);
+}
+
+template <typename SampleType>
+void ChorusPluginAudioProcessor::processSamples(juce::AudioBuffer<SampleType>& buffer)
 {
     juce::ScopedNoDenormals noDenormals;
+    RealtimeGuard::ScopedAudioThread audioThread;
+
+    // the meter's load and deadline figures mean nothing in a bounce
+    bool nonRealtime = isNonRealtime();
+    bool recordTelemetry = telemetry.isActive() && ! nonRealtime;
+    auto startTicks = recordTelemetry ? juce::Time::getHighResolutionTicks() : 0;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -169,110 +285,23 @@ void ChorusPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // processing
-    // only process input channel 0 because mono is assumed
+    // every channel is chorused in place
     int bufferLength = buffer.getNumSamples();
-    int delayBufferLength = delayBuffer.getNumSamples();
-    int dryBufferLength = dryBuffer.getNumSamples();
-
-    auto* inputData = buffer.getReadPointer(0);
-    auto* outputDataR = buffer.getWritePointer(1);
-    auto* outputDataL = buffer.getWritePointer(0);
-
-    auto* delayInputData = delayBuffer.getReadPointer(0);
-    auto* dryInputData = dryBuffer.getReadPointer(0);
-    auto* pitchShiftInputData = pitchShiftBuffer.getWritePointer(0); // rbs will write to here
-    auto* pitchShiftOutputData = pitchShiftBuffer.getReadPointer(0); // then plugin will retrieve from here
-
-    if (delayBufferLength > bufferLength + delayWritePosition) {
-        delayBuffer.copyFromWithRamp(0, delayWritePosition, inputData, bufferLength, 1, 1);
-    }
-    else {
-        int remaining = delayBufferLength - delayWritePosition;
-        delayBuffer.copyFromWithRamp(0, delayWritePosition, inputData, remaining, 1, 1);
-        delayBuffer.copyFromWithRamp(0, 0, inputData, bufferLength - remaining, 1, 1);
-    }
-
-    if (dryBufferLength > bufferLength + dryWritePosition) {
-        dryBuffer.copyFromWithRamp(0, dryWritePosition, inputData, bufferLength, 1, 1);
+    chorus.setParameters(getChorusParameters());
+    chorus.setNonRealtime(nonRealtime);
+    int samplesRetrieved = chorus.process(buffer.getArrayOfReadPointers(), buffer.getArrayOfWritePointers(), bufferLength);
+
+    if (recordTelemetry) {
+        Telemetry::Block block;
+        block.processSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        block.deadlineSeconds = bufferLength / getSampleRate();
+        block.samplesRequested = bufferLength;
+        block.samplesRetrieved = samplesRetrieved;
+        block.latencySamples = getLatencySamples();
+        block.qualityTier = chorus.getQualityTier();
+        block.idle = chorus.isIdle();
+        telemetry.push(block);
     }
-    else {
-        int remaining = dryBufferLength - dryWritePosition;
-        dryBuffer.copyFromWithRamp(0, dryWritePosition, inputData, remaining, 1, 1);
-        dryBuffer.copyFromWithRamp(0, 0, inputData, bufferLength - remaining, 1, 1);
-    }
-
-    // now output the delayed signal
-
-    //rbDelay = rbs->getLatency();
-    //DBG(rbDelay);
-
-    int sampleRate = getSampleRate();
-    //int delayOffset = 0;
-    //int dryOffset = 0;
-    int readPosition = (delayBufferLength + delayWritePosition - (sampleRate*delayOffset/1000)) % delayBufferLength;
-    int dryReadPosition = (dryBufferLength + dryWritePosition - (sampleRate*dryOffset/1000)) % dryBufferLength;
-    //int dryReadPosition = (dryBufferLength + dryWritePosition - getLatency()) % dryBufferLength;
-
-    auto* offsetDelayInputData = delayInputData + readPosition;
-
-    pitchLfo.setFrequency(pitchLfoFreq);
-
-    auto pitchLfoOut = pitchLfo.processSample(0.0f);
-    int pitchLfoCents = pitchLfoOut * pitchLfoDepth;
-
-    double rbsCurrPitchScale = pow(2.0, (pitchCents + pitchLfoCents) / 1200.0);
-
-    rbs->setPitchScale(rbsCurrPitchScale);
-
-    if (delayBufferLength > bufferLength + readPosition) {
-        // send data from delay buffer to rbs to process
-        rbs->process(&offsetDelayInputData, bufferLength, false);
-        
-        // retrieve pitch shifted samples into pitchShiftBuffer
-        size_t numSamplesStretched = rbs->retrieve(&pitchShiftInputData, bufferLength);
-
-        if (numSamplesStretched < bufferLength) {
-            DBG("Dropping " << bufferLength - numSamplesStretched << " samples");
-        }
-
-        // output samples from pitchShiftBuffer
-        buffer.addFrom(1, 0, pitchShiftOutputData, numSamplesStretched);
-    }
-    else {
-        int remaining = delayBufferLength - readPosition;
-
-        rbs->process(&offsetDelayInputData, remaining, false);
-        size_t numSamplesStretched = rbs->retrieve(&pitchShiftInputData, remaining);
-        if (numSamplesStretched < bufferLength) {
-            DBG("Dropping " << bufferLength - numSamplesStretched << " samples");
-        }
-        buffer.addFrom(1, 0, pitchShiftOutputData, numSamplesStretched);
-
-        auto remainingDelayInputData = offsetDelayInputData + remaining;
-
-        rbs->process(&remainingDelayInputData, bufferLength - remaining, false);
-        numSamplesStretched = rbs->retrieve(&pitchShiftInputData, bufferLength - remaining);
-        if (numSamplesStretched < bufferLength) {
-            DBG("Dropping " << bufferLength - numSamplesStretched << " samples");
-        }
-        buffer.addFrom(1, remaining, pitchShiftOutputData, numSamplesStretched);
-    }
-
-    if (dryBufferLength > bufferLength + dryReadPosition) {
-        buffer.copyFrom(0, 0, dryInputData + dryReadPosition, bufferLength);
-    }
-    else {
-        int remaining = dryBufferLength - dryReadPosition;
-        buffer.copyFrom(0, 0, dryInputData + dryReadPosition, remaining);
-        buffer.copyFrom(0, remaining, dryInputData, bufferLength - remaining);
-    }
-
-    // ----------------------------------
-    delayWritePosition += bufferLength;
-    delayWritePosition %= delayBufferLength;
-    dryWritePosition += bufferLength;
-    dryWritePosition %= dryBufferLength;
 }
 
 //==============================================================================
@@ -289,15 +318,17 @@ juce::AudioProcessorEditor* ChorusPluginAudioProcessor::createEditor()
 //==============================================================================
 void ChorusPluginAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    auto state = parameters.copyState();
+    std::unique_ptr<juce::XmlElement> xml(state.createXml());
+    copyXmlToBinary(*xml, destData);
 }
 
 void ChorusPluginAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    std::unique_ptr<juce::XmlElement> xml(getXmlFromBinary(data, sizeInBytes));
+
+    if (xml != nullptr && xml->hasTagName(parameters.state.getType()))
+        parameters.replaceState(juce::ValueTree::fromXml(*xml));
 }
 
 //==============================================================================
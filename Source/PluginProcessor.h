@@ -8,13 +8,16 @@
 
 #pragma once
 
-#include <rubberband/RubberBandStretcher.h>
 #include <JuceHeader.h>
+#include "ChorusDSP.h"
+#include "Telemetry.h"
 
 //==============================================================================
 /**
 */
-class ChorusPluginAudioProcessor  : public juce::AudioProcessor
+class ChorusPluginAudioProcessor  : public juce::AudioProcessor,
+                                    private juce::AudioProcessorValueTreeState::Listener,
+                                    private juce::Timer
 {
 public:
     //==============================================================================
@@ -29,9 +32,11 @@ public:
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
    #endif
 
-    int getLatency();
-
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    // hosts mixing in double precision hand their buffers over without converting them
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -56,35 +61,81 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
-    int delayOffset = 0;
-    int dryOffset = 0;
-    int pitchCents = 5;
+    enum EngineMode
+    {
+        pitchShiftEngine = ChorusDSP::pitchShiftEngine,
+        delayLineEngine = ChorusDSP::delayLineEngine,
+        granularEngine = ChorusDSP::granularEngine
+    };
 
-    float pitchLfoFreq = 1.0; // Hz
-    int pitchLfoDepth = 10;
+    // Host-visible parameters. The editor attaches to these, and the audio
+    // thread only ever reads their atomics.
+    juce::AudioProcessorValueTreeState& getValueTreeState() { return parameters; }
 
-private:
-    juce::AudioBuffer<float> delayBuffer;
-    juce::AudioBuffer<float> dryBuffer;
-    juce::AudioBuffer<float> pitchShiftBuffer;    
-    int delayWritePosition{ 0 };
-    int dryWritePosition{ 0 };
+    static constexpr double maxDelayMs = ChorusDSP::maxDelayMs; // range of the delay slider, either side of zero
 
-    // LFOs
-    const int lfoUpdateRate = 100; // we do not need to update the lfo as frequently, update every sampleRate/lfoUpdateRate samples
-    juce::dsp::Oscillator<float> pitchLfo;
+    // Memory held by the input history, used to keep an eye on per-instance footprint
+    size_t getHistoryFootprintBytes() const { return chorus.getHistoryFootprintBytes(); }
 
-    // Realtime processing for plugins, all other options are default
-    const int rbsOptions = RubberBand::RubberBandStretcher::Option::OptionProcessRealTime
-                        + RubberBand::RubberBandStretcher::Option::OptionPitchHighConsistency;
+    // Block timing and stretcher underruns, recorded only while a
+    // Telemetry::Reader is attached (the editor's meter, ChorusBench, ...)
+    Telemetry& getTelemetry() { return telemetry; }
 
-    const double rbsDefaultTimeRatio = 1.0;
-    //const double rbsDefaultPitchScale = pow(2.0, 10/1200.0); // 1.005792941; // TODO: change this to suitable default pitch shift
-    const double rbsDefaultPitchScale = 1.0;
+    // Silent blocks in a row, on top of the tail, before the engines stop
+    // running. Call before prepareToPlay().
+    void setIdleHoldBlocks(int numBlocks) { chorus.setIdleHoldBlocks(numBlocks); }
 
-    int rbDelay;
+    // The QualityGovernor::Tier the processor runs at. Always full unless
+    // the adaptive quality parameter is on.
+    int getQualityTier() const { return chorus.getQualityTier(); }
+
+private:
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void timerCallback() override;
+
+    // the parameters' current values, as the DSP takes them
+    ChorusDSP::Parameters getChorusParameters() const;
+    ChorusDSP::Options getChorusOptions() const;
+
+    // Low latency trades some pitch-shift smoothness for roughly half the
+    // RubberBand latency, for live monitoring. The worker pool moves the
+    // stretching off the audio thread for a block more, and the adaptive
+    // quality steps down to cheaper tiers under load. Runs on the message
+    // thread: the DSP is prepared again while processing is suspended.
+    void updateEngineOptions();
+
+    // Reports the wet path's latency to the host if it has moved. Message
+    // thread only: hosts may restart processing to compensate.
+    void updateLatency();
+
+    // both processBlock() overloads
+    template <typename SampleType>
+    void processSamples(juce::AudioBuffer<SampleType>& buffer);
+
+    juce::AudioProcessorValueTreeState parameters;
+
+    std::atomic<float>* delayParameter = nullptr;         // ms, negative values delay the dry tap instead
+    std::atomic<float>* pitchParameter = nullptr;         // cents
+    std::atomic<float>* lfoFrequencyParameter = nullptr;  // Hz
+    std::atomic<float>* lfoDepthParameter = nullptr;      // cents
+    std::atomic<float>* voicesParameter = nullptr;        // delay-line engine only
+    std::atomic<float>* engineParameter = nullptr;
+    std::atomic<float>* interpolationParameter = nullptr;
+    std::atomic<float>* mixParameter = nullptr;           // %, 50 keeps dry and wet at full level
+    std::atomic<float>* feedbackParameter = nullptr;      // %
+    std::atomic<float>* outputGainParameter = nullptr;    // dB
+    std::atomic<float>* lowLatencyParameter = nullptr;
+    std::atomic<float>* workerPoolParameter = nullptr;    // stretch on the threads shared by every instance
+    std::atomic<float>* adaptiveQualityParameter = nullptr;
+
+    ChorusDSP chorus;
+    Telemetry telemetry;
+
+    // raised by parameterChanged(), which may run on the audio thread
+    std::atomic<bool> optionsChanged { false };
 
-    std::unique_ptr<RubberBand::RubberBandStretcher> rbs;    
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChorusPluginAudioProcessor)
 };
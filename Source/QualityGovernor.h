@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    QualityGovernor.h
+
+    Watches how much of each block's deadline processing takes and picks a
+    quality tier for the blocks that follow. It steps down quickly when the
+    headroom runs out and back up only after the load has stayed low for a
+    while, so it does not hunt between two tiers.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+/**
+*/
+class QualityGovernor
+{
+public:
+    enum Tier
+    {
+        full = 0,
+        fastPitch,      // RubberBand's speed-oriented pitch shifting
+        fewerVoices,    // half the delay-line voices
+        delayLine,      // the delay-line engine in place of RubberBand
+        numTiers
+    };
+
+    static constexpr float stepDownLoad = 0.8f;     // smoothed load, or a single missed deadline
+    static constexpr float stepUpLoad = 0.4f;
+    static constexpr double smoothingSeconds = 0.25;
+    static constexpr double dwellSeconds = 0.5;     // shortest time on a tier before stepping down again
+    static constexpr double recoverySeconds = 3.0;  // low load needed before stepping up, at first
+    static constexpr int maxBackoff = 8;            // recovery gets this much longer at most
+
+    void prepare(double sampleRate)
+    {
+        smoothingSamples = sampleRate * smoothingSeconds;
+        dwellSamples = (int) (sampleRate * dwellSeconds);
+        baseRecoverySamples = (int) (sampleRate * recoverySeconds);
+        reset();
+    }
+
+    void reset()
+    {
+        tier = full;
+        recoverySamples = baseRecoverySamples;
+        steppedUp = false;
+        smoothedLoad = 0.0f;
+        samplesOnTier = 0;
+        samplesUnderLoad = 0;
+    }
+
+    // Takes the processing time over the deadline of one block and returns
+    // the tier for the next. availableTiers has a bit set for every tier
+    // that would change anything for the current settings; the others are
+    // skipped over.
+    int update(float load, int numSamples, int availableTiers)
+    {
+        float coefficient = (float) juce::jmin(1.0, numSamples / smoothingSamples);
+        smoothedLoad += coefficient * (load - smoothedLoad);
+
+        samplesOnTier = juce::jmin(samplesOnTier + numSamples, std::numeric_limits<int>::max() / 2);
+        samplesUnderLoad = smoothedLoad < stepUpLoad ? juce::jmin(samplesUnderLoad + numSamples, recoverySamples) : 0;
+
+        if ((smoothedLoad > stepDownLoad || load > 1.0f) && samplesOnTier >= dwellSamples) {
+            for (int lower = tier + 1; lower < numTiers; ++lower) {
+                if ((availableTiers & (1 << lower)) != 0) {
+                    // a step up that could not be sustained makes the next one wait longer
+                    if (steppedUp && samplesOnTier < 2 * recoverySamples)
+                        recoverySamples = juce::jmin(2 * recoverySamples, maxBackoff * baseRecoverySamples);
+
+                    moveTo(lower);
+                    steppedUp = false;
+                    break;
+                }
+            }
+        }
+        else if (samplesUnderLoad >= recoverySamples && tier > full) {
+            int higher = tier - 1;
+
+            while (higher > full && (availableTiers & (1 << higher)) == 0)
+                --higher;
+
+            moveTo(higher);
+            steppedUp = true;
+        }
+        else if (steppedUp && samplesOnTier >= 2 * recoverySamples) {
+            // the last step up held
+            recoverySamples = baseRecoverySamples;
+            steppedUp = false;
+        }
+
+        return tier;
+    }
+
+    int getTier() const { return tier; }
+    float getSmoothedLoad() const { return smoothedLoad; }
+
+    static const char* getTierName(int tier)
+    {
+        const char* const names[] = { "full", "fast pitch", "fewer voices", "delay line" };
+        return names[juce::jlimit(0, numTiers - 1, tier)];
+    }
+
+private:
+    void moveTo(int newTier)
+    {
+        tier = newTier;
+        samplesOnTier = 0;
+        samplesUnderLoad = 0;
+    }
+
+    int tier = full;
+    float smoothedLoad = 0.0f;
+    double smoothingSamples = 12000.0;
+    int dwellSamples = 24000;
+    int baseRecoverySamples = 144000;
+    int recoverySamples = 144000;
+    bool steppedUp = false;
+    int samplesOnTier = 0;
+    int samplesUnderLoad = 0;
+};
@@ -0,0 +1,237 @@
+/*
+  ==============================================================================
+
+    RealtimeGuard.cpp
+
+  ==============================================================================
+*/
+
+#include "RealtimeGuard.h"
+
+#if CHORUS_REALTIME_GUARD
+
+#if ! JUCE_LINUX
+ #error "The realtime guard replaces the glibc allocator and is only available on Linux"
+#endif
+
+#include <cerrno>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <unistd.h>
+
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+}
+
+namespace
+{
+    // Static TLS, so that touching these from inside malloc never allocates
+    __attribute__((tls_model("initial-exec"))) thread_local int audioThreadDepth = 0;
+    __attribute__((tls_model("initial-exec"))) thread_local bool insideGuard = false;
+
+    constexpr int maxRecords = 64;
+    constexpr int maxFrames = 32;
+
+    struct Record
+    {
+        RealtimeGuard::Kind kind;
+        int numFrames;
+        void* frames[maxFrames];
+    };
+
+    // records are claimed with one atomic increment, so recording never locks
+    Record records[maxRecords];
+    std::atomic<int> numRecords{ 0 };
+    std::atomic<int> counters[RealtimeGuard::numKinds];
+    std::atomic<bool> detectLocks{ false };
+
+    using MutexLockFunction = int (*)(pthread_mutex_t*);
+    std::atomic<MutexLockFunction> nextMutexLock{ nullptr };
+
+    const char* const kindNames[] = { "allocation", "deallocation", "lock" };
+
+    // backtrace() loads libgcc and allocates the first time it runs, which has
+    // to happen before it is needed on the audio thread
+    struct Warmup
+    {
+        Warmup()
+        {
+            void* frames[2];
+            backtrace(frames, 2);
+        }
+    };
+
+    Warmup warmup;
+
+    inline void check(RealtimeGuard::Kind kind)
+    {
+        if (audioThreadDepth > 0 && ! insideGuard)
+            RealtimeGuard::recordViolation(kind);
+    }
+}
+
+//==============================================================================
+RealtimeGuard::ScopedAudioThread::ScopedAudioThread()   { ++audioThreadDepth; }
+RealtimeGuard::ScopedAudioThread::~ScopedAudioThread()  { --audioThreadDepth; }
+
+void RealtimeGuard::setDetectLocks(bool shouldDetectLocks)  { detectLocks = shouldDetectLocks; }
+
+int RealtimeGuard::getNumViolations()
+{
+    int total = 0;
+
+    for (auto& counter : counters)
+        total += counter.load();
+
+    return total;
+}
+
+int RealtimeGuard::getNumViolations(Kind kind)
+{
+    return counters[kind].load();
+}
+
+void RealtimeGuard::resetViolations()
+{
+    for (auto& counter : counters)
+        counter = 0;
+
+    numRecords = 0;
+}
+
+void RealtimeGuard::recordViolation(Kind kind)
+{
+    insideGuard = true;
+    ++counters[kind];
+
+    int index = numRecords.fetch_add(1);
+
+    if (index < maxRecords) {
+        auto& record = records[index];
+        record.kind = kind;
+        record.numFrames = backtrace(record.frames, maxFrames);
+    }
+
+    insideGuard = false;
+}
+
+void RealtimeGuard::dumpViolations(FILE* stream)
+{
+    int numStored = juce::jmin(numRecords.load(), maxRecords);
+
+    std::fprintf(stream, "Audio thread violations: %d allocations, %d deallocations, %d locks\n",
+                 getNumViolations(allocation), getNumViolations(deallocation), getNumViolations(lock));
+
+    for (int i = 0; i < numStored; ++i) {
+        std::fprintf(stream, "#%d %s\n", i, kindNames[records[i].kind]);
+        std::fflush(stream);
+
+        // skip the frame of the guard itself
+        int skip = juce::jmin(1, records[i].numFrames);
+        backtrace_symbols_fd(records[i].frames + skip, records[i].numFrames - skip, fileno(stream));
+    }
+
+    if (numRecords.load() > maxRecords)
+        std::fprintf(stream, "(%d more not stored)\n", numRecords.load() - maxRecords);
+}
+
+//==============================================================================
+// malloc family
+
+extern "C"
+{
+    void* malloc(size_t size)                       { check(RealtimeGuard::allocation); return __libc_malloc(size); }
+    void* calloc(size_t count, size_t size)         { check(RealtimeGuard::allocation); return __libc_calloc(count, size); }
+    void* realloc(void* p, size_t size)             { check(RealtimeGuard::allocation); return __libc_realloc(p, size); }
+    void* memalign(size_t alignment, size_t size)   { check(RealtimeGuard::allocation); return __libc_memalign(alignment, size); }
+    void* aligned_alloc(size_t alignment, size_t size) { check(RealtimeGuard::allocation); return __libc_memalign(alignment, size); }
+
+    int posix_memalign(void** result, size_t alignment, size_t size)
+    {
+        check(RealtimeGuard::allocation);
+        *result = __libc_memalign(alignment, size);
+        return *result != nullptr ? 0 : ENOMEM;
+    }
+
+    void free(void* p)
+    {
+        if (p != nullptr)
+            check(RealtimeGuard::deallocation);
+
+        __libc_free(p);
+    }
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        if (detectLocks.load(std::memory_order_relaxed))
+            check(RealtimeGuard::lock);
+
+        // static constructors may lock before anything here has run, so the real
+        // function is looked up on first use
+        auto next = nextMutexLock.load(std::memory_order_relaxed);
+
+        if (next == nullptr) {
+            next = (MutexLockFunction) dlsym(RTLD_NEXT, "pthread_mutex_lock");
+            nextMutexLock = next;
+        }
+
+        return next(mutex);
+    }
+}
+
+//==============================================================================
+// operator new and delete, which do not all go through malloc in every standard library
+
+void* operator new(size_t size)
+{
+    check(RealtimeGuard::allocation);
+
+    if (auto* p = __libc_malloc(size == 0 ? 1 : size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)                                   { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept     { check(RealtimeGuard::allocation); return __libc_malloc(size == 0 ? 1 : size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept   { check(RealtimeGuard::allocation); return __libc_malloc(size == 0 ? 1 : size); }
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    check(RealtimeGuard::allocation);
+
+    if (auto* p = __libc_memalign((size_t) alignment, size == 0 ? 1 : size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)       { return operator new(size, alignment); }
+
+void operator delete(void* p) noexcept                              { free(p); }
+void operator delete[](void* p) noexcept                            { free(p); }
+void operator delete(void* p, size_t) noexcept                      { free(p); }
+void operator delete[](void* p, size_t) noexcept                    { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept            { free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept          { free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept    { free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept  { free(p); }
+
+#else
+
+//==============================================================================
+void RealtimeGuard::setDetectLocks(bool)        {}
+int RealtimeGuard::getNumViolations()           { return 0; }
+int RealtimeGuard::getNumViolations(Kind)       { return 0; }
+void RealtimeGuard::resetViolations()           {}
+void RealtimeGuard::recordViolation(Kind)       {}
+void RealtimeGuard::dumpViolations(FILE*)       {}
+
+#endif
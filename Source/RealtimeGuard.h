@@ -0,0 +1,74 @@
+/*
+  ==============================================================================
+
+    RealtimeGuard.h
+
+    Debug and profiling aid that flags heap allocations, and optionally mutex
+    locks, made on the audio thread. Built with CHORUS_REALTIME_GUARD=1 it
+    replaces operator new/delete and the malloc family (and wraps
+    pthread_mutex_lock), and every call made inside a ScopedAudioThread is
+    counted and its stack captured. Without the flag everything here compiles
+    to nothing.
+
+    The allocator can only be replaced for a whole executable, so this is
+    meant for the headless tools (ChorusBench, ...) on Linux rather than for
+    the plugin inside a host.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef CHORUS_REALTIME_GUARD
+ #define CHORUS_REALTIME_GUARD 0
+#endif
+
+//==============================================================================
+/**
+*/
+class RealtimeGuard
+{
+public:
+    enum Kind
+    {
+        allocation = 0,
+        deallocation,
+        lock,
+        numKinds
+    };
+
+    static constexpr bool isEnabled = CHORUS_REALTIME_GUARD != 0;
+
+    // Marks the calling thread as the audio thread for the lifetime of the
+    // object. Scopes may nest.
+    struct ScopedAudioThread
+    {
+       #if CHORUS_REALTIME_GUARD
+        ScopedAudioThread();
+        ~ScopedAudioThread();
+       #else
+        ScopedAudioThread() {}
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedAudioThread)
+    };
+
+    // Lock acquisition is only reported once this is switched on, as some
+    // hosts lock around the callback themselves.
+    static void setDetectLocks(bool shouldDetectLocks);
+
+    static int getNumViolations();
+    static int getNumViolations(Kind kind);
+    static void resetViolations();
+
+    // Prints every recorded violation with its stack. Call from a normal thread.
+    static void dumpViolations(FILE* stream);
+
+    // called by the interceptors
+    static void recordViolation(Kind kind);
+
+private:
+    RealtimeGuard() = delete;
+};
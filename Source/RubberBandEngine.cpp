@@ -0,0 +1,514 @@
+/*
+  ==============================================================================
+
+    RubberBandEngine.cpp
+
+  ==============================================================================
+*/
+
+#include "RubberBandEngine.h"
+
+//==============================================================================
+RubberBandEngine::~RubberBandEngine()
+{
+    releaseJobs();
+}
+
+void RubberBandEngine::prepare(double sampleRate, int maxBlockSize, int newNumChannels, double controlRate)
+{
+    jassert(newNumChannels > 0 && newNumChannels <= HistoryRing::maxChannels);
+    numChannels = newNumChannels;
+
+    // a worker may still be stretching, or priming, with the old rbs
+    releaseJobs();
+    primePending = false;
+    jobMargin = useWorkerPool ? maxBlockSize : 0;
+
+    // initialize LFO objects
+    juce::dsp::ProcessSpec pitchLfoSpec = { controlRate, (juce::uint32) maxBlockSize, 1 };
+    pitchLfo.prepare(pitchLfoSpec);
+
+    if (! pitchLfo.isInitialised())
+        pitchLfo.initialise([](float x) {return std::sin(x); }, 128);
+
+    // create rubberbandstretcher object
+    // One stretcher handles every channel so they stay phase-locked to each other.
+    // Hosts prepare again on every transport start and buffer size change,
+    // which leaves the stretcher as it was unless the rate, the channels or
+    // the window size moved.
+    int options = (fastPitch ? rbsFastPitchOptions : rbsOptions) + (lowLatency ? rbsLowLatencyOptions : 0);
+
+    if (rbs == nullptr || sampleRate != preparedSampleRate || numChannels != preparedNumChannels || options != preparedOptions) {
+        rbs = std::make_unique<RubberBand::RubberBandStretcher>(sampleRate, (size_t) numChannels, options, rbsDefaultTimeRatio, rbsDefaultPitchScale);
+        preparedSampleRate = sampleRate;
+        preparedNumChannels = numChannels;
+        preparedOptions = options;
+
+        // A first priming finds out how much input rbs asks for at a time,
+        // which sizes the output FIFO. reset() primes it again with the real sizes.
+        allocateBuffers(0);
+        outputFifo.setTotalSize(1);
+        latencySamples = 0;
+        prime();
+        stretcherLatencyBound = measureLatencyBound();
+    }
+
+    // the padding up to the latency bound is queued too
+    allocateBuffers(juce::nextPowerOfTwo(2 * (3 * steadyRequired + jobMargin) + maxBlockSize + maxRequired + stretcherLatencyBound) + 1);
+    outputFifo.setTotalSize(outputBuffer.getNumSamples());
+
+    // The latency is only known once a priming has measured the blocking,
+    // so this one goes without padding until it is
+    jobCentreCents = centreCents;
+    jobCents = centreCents;
+    latencySamples = 0;
+    reset();
+    latencySamples = blockingLatency + stretcherLatencyBound;
+    queuePadding();
+
+    // the input waiting for a full stretcher block is read back from the
+    // history too, plus a block more with the workers
+    maxLatency = latencySamples + maxRequired + jobMargin;
+
+    // The pool primes the stretcher whenever the engine goes on standby, and
+    // stretches with it as well if the worker option is on
+    if (workerPool == nullptr)
+        workerPool = std::make_unique<juce::SharedResourcePointer<WorkerPool>>();
+
+    primeSlot = (*workerPool)->addJob(primeJob);
+    ready = true;
+
+    if (useWorkerPool)
+        jobSlot = (*workerPool)->addJob(job);
+}
+
+void RubberBandEngine::reset()
+{
+    pitchLfo.reset();
+    prime();
+}
+
+void RubberBandEngine::standby()
+{
+    ready.store(false, std::memory_order_relaxed);
+    primePending = true;
+    submitPrime();
+}
+
+bool RubberBandEngine::isReady()
+{
+    for (;;) {
+        if (primePending)
+            submitPrime();
+
+        // Offline, the change of engine is not put off: a priming no worker
+        // has started yet is taken back and run here
+        if (nonRealtime && ! primePending && ! ready.load(std::memory_order_acquire)
+            && (*workerPool)->claim(primeSlot)) {
+            primeJob.run();
+            (*workerPool)->collect(primeSlot);
+        }
+
+        if (ready.load(std::memory_order_acquire) || ! nonRealtime)
+            return ready.load(std::memory_order_acquire);
+
+        juce::Thread::yield();
+    }
+}
+
+void RubberBandEngine::submitPrime()
+{
+    auto& pool = **workerPool;
+
+    // A stretch job still running has rbs. One no worker has started yet is
+    // dropped, as the priming starts rbs over anyway.
+    if (jobSlot >= 0) {
+        switch (pool.getState(jobSlot)) {
+        case WorkerPool::State::queued:
+            if (! pool.claim(jobSlot))
+                return;
+
+            JUCE_FALLTHROUGH
+
+        case WorkerPool::State::done:
+            pool.collect(jobSlot);
+            break;
+
+        case WorkerPool::State::running:
+            return;
+
+        default:
+            break;
+        }
+    }
+
+    // with no slot left in the pool, the audio thread primes rbs itself
+    if (primeSlot < 0) {
+        primeJob.run();
+        primePending = false;
+        return;
+    }
+
+    // the last priming is collected here, the first time the slot is needed again
+    if (pool.getState(primeSlot) == WorkerPool::State::done)
+        pool.collect(primeSlot);
+
+    if (pool.submit(primeSlot))
+        primePending = false;
+}
+
+void RubberBandEngine::PrimeJob::run()
+{
+    engine.reset();
+    engine.ready.store(true, std::memory_order_release);
+}
+
+void RubberBandEngine::allocateBuffers(int outputSize)
+{
+    size_t required = (size_t) numChannels * (size_t) (primeChunkSize + outputSize);
+
+    if (required > arenaSize) {
+        arena.allocate(required, false);
+        arenaSize = required;
+    }
+
+    float* primeChannels[HistoryRing::maxChannels];
+    float* outputChannels[HistoryRing::maxChannels];
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        primeChannels[ch] = arena + (size_t) ch * primeChunkSize;
+        outputChannels[ch] = arena + (size_t) numChannels * primeChunkSize + (size_t) ch * (size_t) outputSize;
+    }
+
+    primeBuffer.setDataToReferTo(primeChannels, numChannels, primeChunkSize);
+    outputBuffer.setDataToReferTo(outputChannels, numChannels, outputSize);
+}
+
+void RubberBandEngine::releaseJobs()
+{
+    for (auto* slot : { &jobSlot, &primeSlot }) {
+        if (*slot >= 0)
+            (*workerPool)->removeJob(*slot);
+
+        *slot = -1;
+    }
+}
+
+bool RubberBandEngine::collectJob()
+{
+    if (jobSlot < 0)
+        return true;
+
+    auto& pool = **workerPool;
+
+    for (;;) {
+        switch (pool.getState(jobSlot)) {
+        case WorkerPool::State::queued:
+            // No worker started it within a block: its output is due now, so it
+            // runs here instead. A worker that took it in the meantime has it.
+            if (! pool.claim(jobSlot))
+                break;
+
+            job.run();
+            JUCE_FALLTHROUGH
+
+        case WorkerPool::State::done:
+            pendingInput -= job.consumed;
+            pool.collect(jobSlot);
+            return true;
+
+        case WorkerPool::State::running:
+            break;
+
+        default:
+            return true;
+        }
+
+        // A bounce has no deadline to miss, so the worker is given the time
+        // it needs and the output comes out as if it had kept up
+        if (! nonRealtime)
+            return false;
+
+        juce::Thread::yield();
+    }
+}
+
+void RubberBandEngine::StretchJob::run()
+{
+    engine.applyPitch(engine.jobCentreCents.load(std::memory_order_relaxed),
+                      engine.jobCents.load(std::memory_order_relaxed));
+    consumed = engine.stretch(input, available);
+}
+
+int RubberBandEngine::measureLatencyBound()
+{
+    // The latency scales with the inverse of the pitch, but is worked out
+    // from the settings alone, so nothing has to be stretched to measure it
+    int bound = 0;
+
+    for (auto option : { RubberBand::RubberBandStretcher::Option::OptionPitchHighConsistency,
+                         RubberBand::RubberBandStretcher::Option::OptionPitchHighSpeed }) {
+        rbs->setPitchOption(option);
+
+        for (auto cents : { -maxSweepCents, maxSweepCents }) {
+            rbs->setPitchScale((*centsToRatio)(cents));
+            bound = juce::jmax(bound, (int) rbs->getLatency());
+        }
+    }
+
+    rbs->setPitchOption(fastPitch ? RubberBand::RubberBandStretcher::Option::OptionPitchHighSpeed
+                                  : RubberBand::RubberBandStretcher::Option::OptionPitchHighConsistency);
+    rbs->setPitchScale((*centsToRatio)(centreCents));
+    return bound;
+}
+
+void RubberBandEngine::prime()
+{
+    rbs->reset();
+    rbs->setPitchScale((*centsToRatio)(centreCents));
+    outputFifo.reset();
+    pendingInput = 0;
+    lateSamples = 0;
+    maxRequired = 0;
+    primeBuffer.clear();
+
+    // Feed silence until rbs has filled its pipeline, then until it has
+    // produced a few of its steady-state input blocks of output, and a host
+    // block more when the stretching runs a block behind on a worker...
+    int silenceFed = 0, produced = 0;
+    steadyRequired = 0;
+
+    auto feedSilence = [&] {
+        int required = (int) rbs->getSamplesRequired();
+        maxRequired = juce::jmax(maxRequired, required);
+        rbs->process(primeBuffer.getArrayOfReadPointers(), (size_t) juce::jlimit(1, primeChunkSize, required), false);
+        silenceFed += juce::jlimit(1, primeChunkSize, required);
+        return required;
+    };
+
+    while (rbs->available() <= 0)
+        feedSilence();
+
+    // the first block fills the analysis window, so it is much longer than
+    // the ones that follow and would only add latency to the margin
+    do {
+        steadyRequired = juce::jmax(steadyRequired, feedSilence());
+        primeTarget = 3 * juce::jmax(1, steadyRequired) + jobMargin;
+    } while (rbs->available() < primeTarget);
+
+    // ...then throw away all but primeTarget of it. That much output stays
+    // queued ahead of the host, so a host block never has to wait for the
+    // stretcher to finish a block of its own.
+    while (rbs->available() > primeTarget) {
+        int discard = juce::jmin(rbs->available() - primeTarget, primeChunkSize);
+        produced += (int) rbs->retrieve(primeBuffer.getArrayOfWritePointers(), (size_t) discard);
+    }
+
+    primeBuffer.clear();
+
+    if (outputFifo.getTotalSize() > primeTarget)
+        retrieveAvailable();
+
+    // The silence fed went through the stretcher and the discarded output
+    // never reaches the host, which leaves a fixed delay on top of the
+    // stretcher's own latency.
+    blockingLatency = silenceFed - produced;
+    queuePadding();
+}
+
+void RubberBandEngine::queuePadding()
+{
+    // Lower pitches have more latency, up to the bound the host is told
+    // about. Silence queued ahead of the output makes up the difference at
+    // the centre of the sweep, where the wet signal then lines up with the
+    // dry one; the LFO swings it either side, as it always has.
+    int padding = juce::jmin(latencySamples - blockingLatency - (int) rbs->getLatency(), outputFifo.getFreeSpace());
+
+    if (padding <= 0)
+        return;
+
+    int start1, size1, start2, size2;
+    outputFifo.prepareToWrite(padding, start1, size1, start2, size2);
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        juce::FloatVectorOperations::clear(outputBuffer.getWritePointer(ch, start1), size1);
+        juce::FloatVectorOperations::clear(outputBuffer.getWritePointer(ch, start2), size2);
+    }
+
+    outputFifo.finishedWrite(size1 + size2);
+}
+
+void RubberBandEngine::retrieveAvailable()
+{
+    int available = juce::jmin(rbs->available(), outputFifo.getFreeSpace());
+
+    if (available <= 0)
+        return;
+
+    int start1, size1, start2, size2;
+    outputFifo.prepareToWrite(available, start1, size1, start2, size2);
+
+    auto retrieveInto = [&](int start, int size) {
+        float* region[HistoryRing::maxChannels];
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            region[ch] = outputBuffer.getWritePointer(ch, start);
+
+        if (size > 0)
+            rbs->retrieve(region, (size_t) size);
+    };
+
+    retrieveInto(start1, size1);
+    retrieveInto(start2, size2);
+
+    outputFifo.finishedWrite(size1 + size2);
+}
+
+void RubberBandEngine::controlTick(const Parameters& params)
+{
+    pitchLfo.setFrequency(params.lfoFrequency);
+
+    auto pitchLfoOut = pitchLfo.processSample(0.0f);
+    float pitchLfoCents = pitchLfoOut * params.lfoDepthCents;
+
+    // a worker may have rbs, so the job applies the pitch when it next runs
+    if (jobSlot >= 0) {
+        jobCentreCents.store(params.pitchCents, std::memory_order_relaxed);
+        jobCents.store(params.pitchCents + pitchLfoCents, std::memory_order_relaxed);
+        return;
+    }
+
+    applyPitch(params.pitchCents, params.pitchCents + pitchLfoCents);
+}
+
+void RubberBandEngine::applyPitch(float newCentreCents, float cents)
+{
+    // the next priming pads the latency out at the centre
+    centreCents = newCentreCents;
+    rbs->setPitchScale((*centsToRatio)(cents));
+}
+
+int RubberBandEngine::stretch(const float* const* input, int available)
+{
+    int consumed = 0;
+
+    for (;;) {
+        int required = (int) rbs->getSamplesRequired();
+
+        if (required > available - consumed || outputFifo.getFreeSpace() < required)
+            break;
+
+        if (required > 0) {
+            const float* block[HistoryRing::maxChannels];
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                block[ch] = input[ch] + consumed;
+
+            rbs->process(block, (size_t) required, false);
+            consumed += required;
+        }
+
+        int before = outputFifo.getNumReady();
+        retrieveAvailable();
+
+        // nothing required and nothing produced would spin forever
+        if (required == 0 && outputFifo.getNumReady() == before)
+            break;
+    }
+
+    return consumed;
+}
+
+void RubberBandEngine::findPendingInput(const HistoryRing& history, int delaySamples, int numSamples, const float** input) const
+{
+    // the oldest input not yet fed may lie inside the block just written,
+    // i.e. after the write head
+    int oldest = delaySamples + pendingInput - numSamples;
+    int ahead = juce::jmax(0, -oldest);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        input[ch] = history.getReadWindow(ch, juce::jmin(oldest + ahead, history.getMaxDelay())) + ahead;
+}
+
+int RubberBandEngine::process(const HistoryRing& history, const Parameters& params,
+                              float* const* dest, int numDestChannels, int numSamples)
+{
+    jassert(history.getNumChannels() == numChannels && numDestChannels >= numChannels);
+
+    // rbs works on whole samples, so the tap delay is truncated
+    int delaySamples = juce::jmin((int) params.delaySamples, history.getMaxDelay());
+
+    // The wet tap is fed to rbs in exactly the blocks it asks for, whatever
+    // the host block size. Input that does not yet make up a whole block just
+    // waits in the history, where rbs reads it in place.
+    pendingInput += numSamples;
+
+    if (jobSlot >= 0) {
+        // The last block's job is collected, or run here if it never started.
+        // What the host gets now was stretched a block ago, and this block's
+        // input goes to the workers in endBlock().
+        collectJob();
+    }
+    else {
+        const float* wetTapData[HistoryRing::maxChannels];
+        findPendingInput(history, delaySamples, numSamples, wetTapData);
+        pendingInput -= stretch(wetTapData, pendingInput);
+    }
+
+    // Output a late job still owes is skipped once it turns up, so the wet
+    // signal comes back in line with the dry one after a gap
+    if (lateSamples > 0) {
+        int skip = juce::jmin(lateSamples, outputFifo.getNumReady() - numSamples);
+
+        if (skip > 0) {
+            outputFifo.finishedRead(skip);
+            lateSamples -= skip;
+        }
+    }
+
+    // hand back exactly one host block from the output FIFO
+    int start1, size1, start2, size2;
+    outputFifo.prepareToRead(numSamples, start1, size1, start2, size2);
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        juce::FloatVectorOperations::copy(dest[ch], outputBuffer.getReadPointer(ch, start1), size1);
+        juce::FloatVectorOperations::copy(dest[ch] + size1, outputBuffer.getReadPointer(ch, start2), size2);
+    }
+
+    outputFifo.finishedRead(size1 + size2);
+
+    // The priming rules this out inline, but a job may still be running on a
+    // worker. The shortfall is reported through the processor's telemetry.
+    int numSamplesStretched = size1 + size2;
+
+    if (numSamplesStretched < numSamples) {
+        lateSamples += numSamples - numSamplesStretched;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            juce::FloatVectorOperations::clear(dest[ch] + numSamplesStretched, numSamples - numSamplesStretched);
+    }
+
+    // a single mono voice sits in the centre of a stereo pair
+    for (int ch = numChannels; ch < numDestChannels; ++ch)
+        juce::FloatVectorOperations::copy(dest[ch], dest[0], numSamples);
+
+    return numSamplesStretched;
+}
+
+void RubberBandEngine::endBlock(const HistoryRing& history, const Parameters& params)
+{
+    // The whole host block goes out as one job, which has until the next
+    // block to run; submitting at every control tick would have the job
+    // collected again within the same callback. A job still running holds
+    // on to the input, which goes out with the next one.
+    if (jobSlot < 0 || ! collectJob())
+        return;
+
+    // the history has moved past the block, so nothing lies after the write head
+    int delaySamples = juce::jmin((int) params.delaySamples, history.getMaxDelay());
+    findPendingInput(history, delaySamples, 0, job.input);
+    job.available = pendingInput;
+
+    if (! (*workerPool)->submit(jobSlot))
+        pendingInput -= stretch(job.input, job.available);
+}
@@ -0,0 +1,199 @@
+/*
+  ==============================================================================
+
+    RubberBandEngine.h
+
+    High-consistency pitch shifting of the wet tap with RubberBand. This
+    engine renders a single voice; stacking stretchers for more voices would
+    multiply its cost, which is what the delay-line engine is for.
+
+    Optionally the stretching runs on the shared WorkerPool instead of the
+    audio thread: each host block's input is handed over in one job, once
+    the whole block is in, to be stretched while the host plays output
+    stretched a block earlier. A job that no worker has started by the next
+    block is taken back and run inline. Whatever the option, the pool primes
+    the stretcher again whenever the engine goes on standby.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <rubberband/RubberBandStretcher.h>
+#include "ChorusEngine.h"
+#include "ControlScheduler.h"
+#include "WorkerPool.h"
+
+//==============================================================================
+/**
+*/
+class RubberBandEngine  : public ChorusEngine
+{
+public:
+    RubberBandEngine() = default;
+    ~RubberBandEngine() override;
+
+    void prepare(double sampleRate, int maxBlockSize, int numChannels, double controlRate) override;
+    void reset() override;      // primes rbs, so never on the audio thread
+    void standby() override;
+    bool isReady() override;
+    void controlTick(const Parameters& params) override;
+    int process(const HistoryRing& history, const Parameters& params,
+                float* const* dest, int numDestChannels, int numSamples) override;
+    void endBlock(const HistoryRing& history, const Parameters& params) override;
+    int getLatencySamples() const override { return latencySamples; }
+    int getMaxLatencySamples() const override { return maxLatency; }
+
+    // Short analysis windows roughly halve the stretcher's latency, at some
+    // cost in low-frequency smoothness. Takes effect at the next prepare().
+    void setLowLatency(bool shouldUseLowLatency) { lowLatency = shouldUseLowLatency; }
+
+    // Stretches on the process-wide worker threads, one block ahead of the
+    // host, at the cost of a block of latency. Takes effect at the next prepare().
+    void setUseWorkerPool(bool shouldUseWorkerPool) { useWorkerPool = shouldUseWorkerPool; }
+    bool isUsingWorkerPool() const { return jobSlot >= 0; }
+
+    // RubberBand's speed-oriented pitch shifting instead of its consistency
+    // mode, for the quality governor. Takes effect at the next prepare().
+    void setFastPitch(bool shouldUseFastPitch) { fastPitch = shouldUseFastPitch; }
+
+    // Pitch the sweep will swing around, so that the priming at prepare()
+    // pads the latency out there. Control ticks keep it up to date after that.
+    void setCentreCents(float cents) { centreCents = cents; }
+
+    // Audio thread. Rendering offline, a block waits for a worker still
+    // stretching its input rather than going out with a gap in the wet signal.
+    void setNonRealtime(bool shouldBeNonRealtime) { nonRealtime = shouldBeNonRealtime; }
+
+    // Message thread: waits for the jobs a worker is still running and gives
+    // up their slots, so the history can be reallocated. prepare() takes new ones.
+    void releaseJobs();
+
+private:
+    // Primes the stretcher with silence so that enough output is queued for
+    // any host block, and works out the delay that adds.
+    void prime();
+
+    // Queues silence ahead of the stretcher's output, up to the latency the host is told about
+    void queuePadding();
+
+    // rbs latency at the lowest and highest pitch the sweep reaches, in
+    // either pitch mode, so that both modes are bounded alike
+    int measureLatencyBound();
+
+    // Points the prime and output buffers into the arena, which only ever
+    // grows, so preparing again at the same or a smaller size allocates nothing
+    void allocateBuffers(int outputSize);
+
+    // moves whatever rbs has ready into the output FIFO
+    void retrieveAvailable();
+
+    // Feeds rbs whole blocks from input, as far as available and the room
+    // in the output FIFO allow, and returns the number of samples fed
+    int stretch(const float* const* input, int available);
+
+    // points input at the oldest wet tap sample not yet fed to rbs
+    void findPendingInput(const HistoryRing& history, int delaySamples, int numSamples, const float** input) const;
+
+    // moves the stretcher to a new pitch; the latency the host was told stays as it is
+    void applyPitch(float newCentreCents, float cents);
+
+    //==============================================================================
+    // Runs on a worker, or inline when the audio thread claims it back
+    struct StretchJob  : public WorkerPool::Job
+    {
+        explicit StretchJob(RubberBandEngine& e) : engine(e) {}
+        void run() override;
+
+        RubberBandEngine& engine;
+        const float* input[HistoryRing::maxChannels] = {};
+        int available = 0;
+        int consumed = 0;
+    };
+
+    // Collects the job if it has finished, or runs it here if no worker has
+    // started it. False while a worker is still running it, as rbs is then
+    // off limits to the audio thread; offline it waits for the worker instead.
+    bool collectJob();
+
+    // Primes rbs on a worker while the engine is on standby, so that it can
+    // be crossfaded in again without a reset on the audio thread
+    struct PrimeJob  : public WorkerPool::Job
+    {
+        explicit PrimeJob(RubberBandEngine& e) : engine(e) {}
+        void run() override;
+
+        RubberBandEngine& engine;
+    };
+
+    // Audio thread: hands the priming to a worker once the stretch job has
+    // let go of rbs. It stays pending until the pool takes it.
+    void submitPrime();
+
+    std::unique_ptr<juce::SharedResourcePointer<WorkerPool>> workerPool;
+    StretchJob job{ *this };
+    PrimeJob primeJob{ *this };
+    int jobSlot = -1;           // only with the worker pool option
+    int primeSlot = -1;         // always, unless the pool is full
+    bool useWorkerPool = false;
+    bool nonRealtime = false;
+    bool primePending = false;  // on standby, the priming not yet submitted
+    std::atomic<bool> ready{ true };    // primed since the last standby
+    int jobMargin = 0;          // extra output queued to cover the block the job runs behind
+
+    // set at control ticks and picked up by the job
+    std::atomic<float> jobCentreCents{ 0.0f };
+    std::atomic<float> jobCents{ 0.0f };
+
+    int numChannels = 1; // the wet taps are read straight from the history
+
+    // Re-blocking: rbs takes input in the block sizes it asks for and the host
+    // gets its own block size back out of a FIFO of stretched output
+    static constexpr int primeChunkSize = 4096;
+    juce::AudioBuffer<float> primeBuffer;   // silence in, discarded output out
+    juce::AudioBuffer<float> outputBuffer;
+    juce::HeapBlock<float> arena;           // backs both buffers
+    size_t arenaSize = 0;
+    juce::AbstractFifo outputFifo{ 1 };
+    int pendingInput = 0;       // wet tap samples in the history not yet fed to rbs
+    int lateSamples = 0;        // output the host went without, skipped when it arrives
+    int maxRequired = 0;        // largest input block rbs asked for while priming
+    int steadyRequired = 0;     // and the largest after its first analysis window
+    int primeTarget = 0;        // output kept queued ahead of the host
+    int blockingLatency = 0;    // delay added by the priming, on top of rbs->getLatency()
+
+    // LFOs
+    // we do not need to update the lfo as frequently, it advances once per control tick
+    juce::dsp::Oscillator<float> pitchLfo;
+    juce::SharedResourcePointer<CentsToRatioTable> centsToRatio;
+
+    // Realtime processing for plugins, all other options are default
+    const int rbsOptions = RubberBand::RubberBandStretcher::Option::OptionProcessRealTime
+                        + RubberBand::RubberBandStretcher::Option::OptionPitchHighConsistency;
+
+    const int rbsFastPitchOptions = RubberBand::RubberBandStretcher::Option::OptionProcessRealTime
+                                 + RubberBand::RubberBandStretcher::Option::OptionPitchHighSpeed;
+
+    const int rbsLowLatencyOptions = RubberBand::RubberBandStretcher::Option::OptionWindowShort;
+    bool lowLatency = false;
+    bool fastPitch = false;
+
+    const double rbsDefaultTimeRatio = 1.0;
+    //const double rbsDefaultPitchScale = pow(2.0, 10/1200.0); // 1.005792941; // TODO: change this to suitable default pitch shift
+    const double rbsDefaultPitchScale = 1.0;
+
+    // rbs latency depends on the pitch scale. The host is told the blocking
+    // latency plus its bound over the pitch range, which stays fixed until
+    // the next prepare().
+    int latencySamples = 0;
+    int stretcherLatencyBound = 0;
+    int maxLatency = 0;
+    float centreCents = 0.0f;   // the pitch the LFO swings around
+
+    std::unique_ptr<RubberBand::RubberBandStretcher> rbs;
+    double preparedSampleRate = 0.0;    // what rbs was built for
+    int preparedNumChannels = 0;
+    int preparedOptions = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RubberBandEngine)
+};
@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    SilenceDetector.h
+
+    Watches the input peak level block by block and reports the processor as
+    idle once the input has been silent for longer than everything the delay
+    line can still play back. Signal fed back into the history counts as
+    input. While idle the processor skips all engine work.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+//==============================================================================
+/**
+*/
+class SilenceDetector
+{
+public:
+    static constexpr float defaultThreshold = 3.1623e-5f;   // -90 dBFS
+    static constexpr int defaultHoldBlocks = 8;
+
+    // tailSamples is how long output can go on after the input stops
+    void prepare(int newTailSamples)
+    {
+        tailSamples = newTailSamples;
+        reset();
+    }
+
+    void reset()
+    {
+        silentSamples = 0;
+        silentBlocks = 0;
+        idle = false;
+    }
+
+    void setThreshold(float newThreshold)   { threshold = newThreshold; }
+
+    // On top of the tail, this many silent blocks in a row are needed before
+    // going idle, so sparse material does not flip in and out of it.
+    void setHoldBlocks(int newHoldBlocks)   { holdBlocks = juce::jmax(1, newHoldBlocks); }
+
+    // Returns true while the processor may stay idle for this block.
+    template <typename SampleType>
+    bool process(const SampleType* const* channels, int numChannels, int numSamples)
+    {
+        if (! isSilent(channels, numChannels, numSamples)) {
+            reset();
+            return false;
+        }
+
+        // saturates rather than wrapping after a very long silence
+        silentSamples = juce::jmin(silentSamples + numSamples, std::numeric_limits<int>::max() / 2);
+        silentBlocks = juce::jmin(silentBlocks + 1, holdBlocks);
+        idle = silentSamples > tailSamples && silentBlocks >= holdBlocks;
+
+        return idle;
+    }
+
+    bool isIdle() const { return idle; }
+
+    // For the wet signal going back into the history: anything above the
+    // threshold starts the wait for the tail over, as new input would.
+    void processFeedback(const float* const* channels, int numChannels, int numSamples)
+    {
+        if (! isSilent(channels, numChannels, numSamples))
+            reset();
+    }
+
+private:
+    template <typename SampleType>
+    bool isSilent(const SampleType* const* channels, int numChannels, int numSamples) const
+    {
+        for (int ch = 0; ch < numChannels; ++ch) {
+            auto range = juce::FloatVectorOperations::findMinAndMax(channels[ch], numSamples);
+
+            if (range.getEnd() > threshold || range.getStart() < -threshold)
+                return false;
+        }
+
+        return true;
+    }
+
+    float threshold = defaultThreshold;
+    int holdBlocks = defaultHoldBlocks;
+    int tailSamples = 0;
+    int silentSamples = 0;
+    int silentBlocks = 0;
+    bool idle = false;
+};
@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    Telemetry.cpp
+
+  ==============================================================================
+*/
+
+#include "Telemetry.h"
+
+//==============================================================================
+void Telemetry::push(const Block& block)
+{
+    // The audio thread is the only writer. A reader copying the slot
+    // meanwhile finds its sequence changed and drops the record.
+    auto sequence = writeSequence.load(std::memory_order_relaxed);
+    auto& slot = slots[sequence & (capacity - 1)];
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.block = block;
+    slot.sequence.store(sequence + 1, std::memory_order_release);
+    writeSequence.store(sequence + 1, std::memory_order_release);
+}
+
+//==============================================================================
+Telemetry::Reader::Reader(Telemetry& source)
+    : telemetry(source)
+{
+    // starts from now, leaving whatever was recorded before to the other readers
+    readSequence = telemetry.writeSequence.load(std::memory_order_acquire);
+    ++telemetry.numReaders;
+}
+
+Telemetry::Reader::~Reader()
+{
+    --telemetry.numReaders;
+}
+
+bool Telemetry::Reader::read(juce::uint64 sequence, Block& block) const
+{
+    const auto& slot = telemetry.slots[sequence & (capacity - 1)];
+
+    if (slot.sequence.load(std::memory_order_acquire) != sequence + 1)
+        return false;
+
+    block = slot.block;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == sequence + 1;
+}
+
+void Telemetry::Reader::update()
+{
+    auto end = telemetry.writeSequence.load(std::memory_order_acquire);
+
+    // the audio thread has gone round the ring since the last call, so the oldest records are gone
+    if (end - readSequence > (juce::uint64) capacity) {
+        lostRecords += (juce::int64) (end - readSequence - (juce::uint64) capacity);
+        readSequence = end - (juce::uint64) capacity;
+    }
+
+    double processSeconds = 0.0, deadlineSeconds = 0.0;
+
+    for (; readSequence < end; ++readSequence) {
+        Block block;
+
+        if (! read(readSequence, block)) {
+            ++lostRecords;
+            continue;
+        }
+
+        processSeconds += block.processSeconds;
+        deadlineSeconds += block.deadlineSeconds;
+
+        if (block.deadlineSeconds > 0.0)
+            peakLoad = juce::jmax(peakLoad, (float) (block.processSeconds / block.deadlineSeconds));
+
+        if (block.processSeconds > block.deadlineSeconds)
+            ++deadlineMisses;
+
+        droppedSamples += block.samplesRequested - block.samplesRetrieved;
+        latencySamples = block.latencySamples;
+        qualityTier = block.qualityTier;
+        idle = block.idle;
+        ++numBlocks;
+    }
+
+    // no blocks at all means the host has stopped calling us
+    load = deadlineSeconds > 0.0 ? (float) (processSeconds / deadlineSeconds) : 0.0f;
+}
+
+void Telemetry::Reader::resetTotals()
+{
+    load = peakLoad = 0.0f;
+    numBlocks = deadlineMisses = droppedSamples = lostRecords = 0;
+}
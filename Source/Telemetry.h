@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+    Telemetry.h
+
+    Per-block timing and stretcher underrun records, passed from the audio
+    thread to any number of readers through a ring of sequence-numbered
+    slots. The audio thread overwrites the oldest record and never waits;
+    each reader keeps its own place in the ring, and counts the records it
+    fell too far behind to read. Nothing is measured or recorded unless a
+    Reader exists, so the audio path only pays for an atomic load when
+    nobody is looking.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+*/
+class Telemetry
+{
+public:
+    struct Block
+    {
+        double processSeconds = 0.0;
+        double deadlineSeconds = 0.0;   // block size / sample rate
+        int samplesRequested = 0;       // wet samples asked of the engine
+        int samplesRetrieved = 0;       // and actually produced by it
+        int latencySamples = 0;
+        int qualityTier = 0;            // QualityGovernor::Tier
+        bool idle = false;              // skipped for silence
+    };
+
+    // about two seconds of 64-sample blocks at 48 kHz between two reads
+    static constexpr int capacity = 2048;
+    static_assert((capacity & (capacity - 1)) == 0, "the ring capacity must be a power of two");
+
+    Telemetry() = default;
+
+    // audio thread
+    bool isActive() const { return numReaders.load(std::memory_order_relaxed) > 0; }
+    void push(const Block& block);
+
+    //==============================================================================
+    // Reads the records from when it was created and keeps running totals.
+    // Readers do not take records from each other, so the editor's meter and
+    // a benchmark can watch the same processor at once. Recording stops when
+    // the last one is destroyed.
+    class Reader
+    {
+    public:
+        explicit Reader(Telemetry& source);
+        ~Reader();
+
+        // Pulls everything recorded since the last call. Call from one thread only.
+        void update();
+
+        // processing time over the deadline, across the blocks pulled by the last update()
+        float getLoad() const { return load; }
+        float getPeakLoad() const { return peakLoad; }
+
+        juce::int64 getNumBlocks() const { return numBlocks; }
+        juce::int64 getDeadlineMisses() const { return deadlineMisses; }
+        juce::int64 getDroppedSamples() const { return droppedSamples; }
+        int getLatencySamples() const { return latencySamples; }
+        int getQualityTier() const { return qualityTier; }
+        bool isIdle() const { return idle; }
+
+        // records overwritten before this reader got to them, because update() was not called often enough
+        juce::int64 getLostRecords() const { return lostRecords; }
+
+        void resetTotals();
+
+    private:
+        // Copies the record numbered sequence, false if the audio thread has overwritten it
+        bool read(juce::uint64 sequence, Block& block) const;
+
+        Telemetry& telemetry;
+        juce::uint64 readSequence = 0;  // number of the next record to read
+        float load = 0.0f, peakLoad = 0.0f;
+        juce::int64 numBlocks = 0, deadlineMisses = 0, droppedSamples = 0, lostRecords = 0;
+        int latencySamples = 0;
+        int qualityTier = 0;
+        bool idle = false;
+
+        JUCE_DECLARE_NON_COPYABLE (Reader)
+    };
+
+private:
+    // A record goes to slot number & (capacity - 1). Its sequence is zero
+    // while the audio thread writes it and the record's number plus one
+    // after, so a reader can tell a record from the one that replaced it.
+    struct Slot
+    {
+        std::atomic<juce::uint64> sequence{ 0 };
+        Block block;
+    };
+
+    Slot slots[capacity];
+    std::atomic<juce::uint64> writeSequence{ 0 };  // records pushed so far
+    std::atomic<int> numReaders{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Telemetry)
+};
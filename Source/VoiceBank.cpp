@@ -0,0 +1,213 @@
+/*
+  ==============================================================================
+
+    VoiceBank.cpp
+
+  ==============================================================================
+*/
+
+#include "VoiceBank.h"
+
+//==============================================================================
+VoiceBank::VoiceBank()
+{
+    for (int v = 0; v < maxLanes; ++v) {
+        lfoSin[v] = 0.0f;
+        lfoCos[v] = 1.0f;
+        delayOffset[v] = depthScale[v] = gain[v] = gainLeft[v] = gainRight[v] = 0.0f;
+
+        for (int c = 0; c < HistoryRing::maxChannels; ++c)
+            allpassState[c][v] = 0.0f;
+    }
+
+    setNumVoices(1);
+}
+
+void VoiceBank::prepare(double sampleRate, int maxBlockSize)
+{
+    currentSampleRate = sampleRate;
+
+    // only a larger block size needs new buffers
+    if (maxBlockSize > maxSamples) {
+        voiceDelays.allocate((size_t) maxLanes * (size_t) maxBlockSize, true);
+        voiceBuffer.allocate((size_t) maxLanes * (size_t) maxBlockSize, true);
+        maxSamples = maxBlockSize;
+    }
+
+    int voices = numVoices;
+    numVoices = 0;
+    setNumVoices(voices);
+    reset();
+}
+
+void VoiceBank::reset()
+{
+    auto twoPi = juce::MathConstants<float>::twoPi;
+
+    // the sweep starts at its shortest delay, as a single voice always has
+    for (int v = 0; v < maxLanes; ++v) {
+        float phase = twoPi * (float) v / (float) numVoices;
+        lfoSin[v] = -std::cos(phase);
+        lfoCos[v] = std::sin(phase);
+
+        for (int c = 0; c < HistoryRing::maxChannels; ++c)
+            allpassState[c][v] = 0.0f;
+    }
+}
+
+void VoiceBank::setNumVoices(int newNumVoices)
+{
+    newNumVoices = juce::jlimit(1, maxVoices, newNumVoices);
+
+    if (newNumVoices == numVoices)
+        return;
+
+    auto twoPi = juce::MathConstants<float>::twoPi;
+    auto halfPi = juce::MathConstants<float>::halfPi;
+    float spreadSamples = (float) (currentSampleRate * delaySpreadMs / 1000.0);
+    float normalisation = 1.0f / std::sqrt((float) newNumVoices);
+
+    for (int v = 0; v < maxLanes; ++v) {
+        bool active = v < newNumVoices;
+        float position = newNumVoices > 1 ? (float) v / (float) (newNumVoices - 1) : 0.0f; // 0..1 across the bank
+
+        // voices that just started get their own point on the LFO cycle
+        if (active && v >= numVoices) {
+            float phase = twoPi * (float) v / (float) newNumVoices;
+            lfoSin[v] = -std::cos(phase);
+            lfoCos[v] = std::sin(phase);
+
+            for (int c = 0; c < HistoryRing::maxChannels; ++c)
+                allpassState[c][v] = 0.0f;
+        }
+
+        delayOffset[v] = active ? position * spreadSamples : 0.0f;
+        depthScale[v] = active ? 1.0f - 0.3f * position : 0.0f;
+
+        // alternate left and right so neighbouring voices land apart
+        float pan = newNumVoices > 1 ? (v % 2 == 0 ? -1.0f : 1.0f) * (0.5f + 0.5f * position) : 0.0f;
+        float angle = (pan + 1.0f) * 0.5f * halfPi;
+
+        gain[v] = active ? normalisation : 0.0f;
+        gainLeft[v] = active ? normalisation * juce::MathConstants<float>::sqrt2 * std::cos(angle) : 0.0f;
+        gainRight[v] = active ? normalisation * juce::MathConstants<float>::sqrt2 * std::sin(angle) : 0.0f;
+    }
+
+    numVoices = newNumVoices;
+}
+
+void VoiceBank::process(const HistoryRing& history, const float* baseDelays, const float* depths,
+                        float lfoFrequency, int interpolation, float* const* dest, int numDestChannels, int numSamples)
+{
+    switch (interpolation) {
+    case DelayInterpolation::linear:
+        processVoices<DelayInterpolation::linear>(history, baseDelays, depths, lfoFrequency, dest, numDestChannels, numSamples);
+        break;
+    case DelayInterpolation::allpass:
+        processVoices<DelayInterpolation::allpass>(history, baseDelays, depths, lfoFrequency, dest, numDestChannels, numSamples);
+        break;
+    default:
+        processVoices<DelayInterpolation::cubic>(history, baseDelays, depths, lfoFrequency, dest, numDestChannels, numSamples);
+        break;
+    }
+}
+
+template <int interpolationType>
+void VoiceBank::processVoices(const HistoryRing& history, const float* baseDelays, const float* depths,
+                              float lfoFrequency, float* const* dest, int numDestChannels, int numSamples)
+{
+    jassert(numSamples <= maxSamples);
+
+    // the kernels read every voice of the bank at once, padded to whole groups
+    // unless there is only one
+    const int numGroups = (numVoices + lanes - 1) / lanes;
+    const int numLanes = numVoices == 1 ? 1 : numGroups * lanes;
+    jassert(numLanes == 1 || numLanes == 4 || numLanes == 8);
+
+    const int numChannels = history.getNumChannels();
+    const int oldest = history.getMaxDelay();
+
+    // a mono history rendered to a stereo pair pans its voices, otherwise each
+    // channel's voices go to the matching dest channel
+    const bool panned = numChannels == 1 && numDestChannels > 1;
+    jassert(panned || numDestChannels == numChannels);
+
+    // the LFOs are rotating phasors, so advancing every voice is two multiply-adds
+    float increment = juce::MathConstants<float>::twoPi * lfoFrequency / (float) currentSampleRate;
+    auto rotateCos = Vec::expand(std::cos(increment));
+    auto rotateSin = Vec::expand(std::sin(increment));
+
+    Vec sinV[maxGroups], cosV[maxGroups], offsetV[maxGroups], depthV[maxGroups];
+
+    for (int g = 0; g < numGroups; ++g) {
+        sinV[g] = Vec::fromRawArray(lfoSin + g * lanes);
+        cosV[g] = Vec::fromRawArray(lfoCos + g * lanes);
+        offsetV[g] = Vec::fromRawArray(delayOffset + g * lanes);
+        depthV[g] = Vec::fromRawArray(depthScale + g * lanes);
+    }
+
+    // The read positions are the same for every channel, so every voice's
+    // delays are worked out once for the whole block, voice by voice within
+    // each sample as the kernels read them
+    alignas(32) float delayLanes[lanes];
+    float* delays = voiceDelays.get();
+
+    for (int i = 0; i < numSamples; ++i) {
+        auto base = Vec::expand(baseDelays[i] + (float) DelayInterpolation::minimumDelay);
+        auto depth = Vec::expand(depths[i]);
+
+        for (int g = 0; g < numGroups; ++g) {
+            // the sweep rides on top of the tap delay, so it never reads ahead of it
+            auto delay = base + offsetV[g] + depth * depthV[g] * (sinV[g] + 1.0f);
+            delay.copyToRawArray(delayLanes);
+
+            for (int lane = 0; lane < juce::jmin(lanes, numLanes); ++lane)
+                delays[(size_t) i * (size_t) numLanes + (size_t) (g * lanes + lane)] = delayLanes[lane];
+
+            auto nextSin = sinV[g] * rotateCos + cosV[g] * rotateSin;
+            cosV[g] = cosV[g] * rotateCos - sinV[g] * rotateSin;
+            sinV[g] = nextSin;
+        }
+    }
+
+    // Every tap lies in one contiguous window starting at the oldest sample, so
+    // reads are plain offsets from it with no wrapping. The headroom the
+    // processor gives the history keeps the sweep inside the window.
+    auto& kernels = Kernels::get();
+    float* voices = voiceBuffer.get();
+
+    for (int c = 0; c < numDestChannels; ++c)
+        juce::FloatVectorOperations::clear(dest[c], numSamples);
+
+    for (int c = 0; c < numChannels; ++c) {
+        const float* window = history.getReadWindow(c, oldest);
+
+        if (interpolationType == DelayInterpolation::cubic)
+            kernels.readCubic(window, oldest, delays, voices, numLanes, numSamples);
+        else if (interpolationType == DelayInterpolation::allpass)
+            kernels.readAllpass(window, oldest, delays, voices, numLanes, numSamples, allpassState[c]);
+        else
+            kernels.readLinear(window, oldest, delays, voices, numLanes, numSamples);
+
+        // the padding lanes past the last voice have no gain, so they add nothing
+        if (panned) {
+            kernels.sumVoices(dest[0], voices, gainLeft, numLanes, numSamples);
+            kernels.sumVoices(dest[1], voices, gainRight, numLanes, numSamples);
+        }
+        else {
+            kernels.sumVoices(dest[c], voices, gain, numLanes, numSamples);
+        }
+    }
+
+    // pull the phasors back onto the unit circle once per block so rounding cannot make them grow or decay
+    for (int g = 0; g < numGroups; ++g) {
+        auto correction = Vec::expand(1.5f) - (sinV[g] * sinV[g] + cosV[g] * cosV[g]) * 0.5f;
+        (sinV[g] * correction).copyToRawArray(lfoSin + g * lanes);
+        (cosV[g] * correction).copyToRawArray(lfoCos + g * lanes);
+    }
+
+    // flush denormals from the allpass recursion
+    for (int c = 0; c < numChannels; ++c)
+        for (int v = 0; v < numLanes; ++v)
+            JUCE_SNAP_TO_ZERO(allpassState[c][v]);
+}
@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    VoiceBank.h
+
+    The detuned voices of the delay-line chorus, stored as structure-of-arrays
+    so that each SIMD register holds one parameter for several voices. All
+    voices read the same history ring, and every channel of the ring is swept
+    by the same LFOs, so the read positions are worked out once per sample for
+    all channels. The voices are then read a block at a time per channel by
+    the Kernels registry, a SIMD lane per voice, and summed.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "DelayInterpolation.h"
+#include "HistoryRing.h"
+#include "Kernels.h"
+
+//==============================================================================
+/**
+*/
+class VoiceBank
+{
+public:
+    static constexpr int maxVoices = 8;
+
+    // total spread of the voices' base delays, so they do not sweep in unison
+    static constexpr float delaySpreadMs = 6.0f;
+
+    VoiceBank();
+
+    void prepare(double sampleRate, int maxBlockSize);
+    void reset();
+
+    // Spreads LFO phase, delay, detune and pan over the first numVoices voices.
+    // Voices that keep running hold their LFO phase so the sweep stays continuous.
+    void setNumVoices(int newNumVoices);
+    int getNumVoices() const { return numVoices; }
+
+    // Renders the sum of all voices for every channel of the history.
+    // baseDelays and depths hold, per sample, the tap delay and the sweep depth
+    // in samples that every voice shares. Each channel's voices are summed into
+    // its own dest channel, except that a mono history rendered into two dest
+    // channels has its voices panned across them.
+    void process(const HistoryRing& history, const float* baseDelays, const float* depths,
+                 float lfoFrequency, int interpolation, float* const* dest, int numDestChannels, int numSamples);
+
+private:
+    template <int interpolationType>
+    void processVoices(const HistoryRing& history, const float* baseDelays, const float* depths,
+                       float lfoFrequency, float* const* dest, int numDestChannels, int numSamples);
+
+    using Vec = DelayInterpolation::Vec;
+    static constexpr int lanes = DelayInterpolation::lanes;
+    static constexpr int maxGroups = (maxVoices + lanes - 1) / lanes;
+    static constexpr int maxLanes = maxGroups * lanes;
+
+    double currentSampleRate = 44100.0;
+    int numVoices = 1;
+
+    // every voice's delay for each sample of the block, and every voice's
+    // taps for a channel, a lane per voice within each sample
+    juce::HeapBlock<float> voiceDelays;
+    juce::HeapBlock<float> voiceBuffer;
+    int maxSamples = 0;
+
+    // per-voice state, one contiguous array per parameter
+    alignas(32) float lfoSin[maxLanes];
+    alignas(32) float lfoCos[maxLanes];
+    alignas(32) float delayOffset[maxLanes];  // samples added to the shared tap delay
+    alignas(32) float depthScale[maxLanes];   // share of the sweep depth, i.e. detune
+    alignas(32) float gain[maxLanes];         // mono sum
+    alignas(32) float gainLeft[maxLanes];
+    alignas(32) float gainRight[maxLanes];
+    float allpassState[HistoryRing::maxChannels][maxLanes];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VoiceBank)
+};
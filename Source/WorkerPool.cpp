@@ -0,0 +1,245 @@
+/*
+  ==============================================================================
+
+    WorkerPool.cpp
+
+  ==============================================================================
+*/
+
+#include "WorkerPool.h"
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+#endif
+
+//==============================================================================
+WorkerPool::Queue::Queue()
+{
+    static_assert((capacity & (capacity - 1)) == 0, "the queue capacity must be a power of two");
+
+    for (int i = 0; i < capacity; ++i)
+        cells[i].sequence.store((size_t) i, std::memory_order_relaxed);
+}
+
+bool WorkerPool::Queue::push(int value)
+{
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+
+    for (;;) {
+        Cell& cell = cells[position & (capacity - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        auto difference = (std::intptr_t) sequence - (std::intptr_t) position;
+
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                cell.value = value;
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0) {
+            return false;   // full
+        }
+        else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool WorkerPool::Queue::pop(int& value)
+{
+    size_t position = dequeuePosition.load(std::memory_order_relaxed);
+
+    for (;;) {
+        Cell& cell = cells[position & (capacity - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        auto difference = (std::intptr_t) sequence - (std::intptr_t) (position + 1);
+
+        if (difference == 0) {
+            if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                value = cell.value;
+                cell.sequence.store(position + capacity, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0) {
+            return false;   // empty
+        }
+        else {
+            position = dequeuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+//==============================================================================
+#if JUCE_WINDOWS
+WorkerPool::Signal::Signal()            { semaphore = CreateSemaphoreW(nullptr, 0, LONG_MAX, nullptr); }
+WorkerPool::Signal::~Signal()           { CloseHandle(semaphore); }
+void WorkerPool::Signal::post()         { ReleaseSemaphore(semaphore, 1, nullptr); }
+void WorkerPool::Signal::wait(int timeoutMs) { WaitForSingleObject(semaphore, (DWORD) timeoutMs); }
+#elif JUCE_MAC || JUCE_IOS
+WorkerPool::Signal::Signal()            { semaphore = dispatch_semaphore_create(0); }
+WorkerPool::Signal::~Signal()           { dispatch_release(semaphore); }
+void WorkerPool::Signal::post()         { dispatch_semaphore_signal(semaphore); }
+
+void WorkerPool::Signal::wait(int timeoutMs)
+{
+    dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t) timeoutMs * (int64_t) NSEC_PER_MSEC));
+}
+#else
+WorkerPool::Signal::Signal()            { sem_init(&semaphore, 0, 0); }
+WorkerPool::Signal::~Signal()           { sem_destroy(&semaphore); }
+void WorkerPool::Signal::post()         { sem_post(&semaphore); }
+
+void WorkerPool::Signal::wait(int timeoutMs)
+{
+    timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long) timeoutMs * 1000000;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec %= 1000000000;
+
+    sem_timedwait(&semaphore, &deadline);
+}
+#endif
+
+//==============================================================================
+WorkerPool::Worker::Worker(WorkerPool& owner, int workerIndex)
+    : juce::Thread("Chorus worker " + juce::String(workerIndex)), pool(owner), index(workerIndex)
+{
+}
+
+void WorkerPool::Worker::run()
+{
+    while (! threadShouldExit()) {
+        int slot;
+
+        if (pool.findWork(index, slot)) {
+            pool.runSlot(slot);
+            continue;
+        }
+
+        // the timeout only bounds how long a stop request can go unnoticed
+        pool.signal.wait(10);
+    }
+}
+
+//==============================================================================
+WorkerPool::WorkerPool()
+{
+    // leave a core for the host's own audio thread
+    int numWorkers = juce::jlimit(1, maxWorkers, juce::SystemStats::getNumCpus() - 1);
+
+    for (int i = 0; i < numWorkers; ++i)
+        workers.add(new Worker(*this, i));
+
+    // JUCE 6's highest priority, which is not a realtime guarantee. On
+    // Windows it is time-critical within the process's priority class. On
+    // Linux and macOS JUCE asks for round-robin scheduling, which Linux only
+    // grants with realtime rights (RLIMIT_RTPRIO or root); without them the
+    // workers run at normal priority.
+    for (auto* worker : workers)
+        worker->startThread(10);
+}
+
+WorkerPool::~WorkerPool()
+{
+    for (auto* worker : workers)
+        worker->signalThreadShouldExit();
+
+    for (int i = 0; i < workers.size(); ++i)
+        signal.post();
+
+    for (auto* worker : workers)
+        worker->stopThread(1000);
+
+    // every instance gives its slot back before letting go of the pool
+    for (auto& slot : slots)
+        jassertquiet(slot.job.load() == nullptr);
+}
+
+int WorkerPool::addJob(Job& job)
+{
+    const juce::ScopedLock sl(slotLock);
+
+    for (int i = 0; i < maxJobs; ++i) {
+        if (slots[i].job.load() == nullptr) {
+            slots[i].job.store(&job);
+            slots[i].state.store((int) State::idle, std::memory_order_release);
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void WorkerPool::removeJob(int slot)
+{
+    jassert(slot >= 0 && slot < maxJobs);
+    const juce::ScopedLock sl(slotLock);
+
+    // a worker that is part-way through the job has to finish it first
+    for (;;) {
+        int state = slots[slot].state.load(std::memory_order_acquire);
+
+        if (state != (int) State::running
+            && slots[slot].state.compare_exchange_strong(state, (int) State::removed, std::memory_order_acq_rel))
+            break;
+
+        juce::Thread::sleep(1);
+    }
+
+    slots[slot].job.store(nullptr);
+}
+
+bool WorkerPool::submit(int slot)
+{
+    int expected = (int) State::idle;
+
+    if (! slots[slot].state.compare_exchange_strong(expected, (int) State::queued, std::memory_order_acq_rel))
+        return false;
+
+    // spread the jobs round the workers; stealing evens out the rest
+    int first = (int) (nextWorker.fetch_add(1, std::memory_order_relaxed) % (unsigned int) workers.size());
+
+    for (int i = 0; i < workers.size(); ++i) {
+        if (workers.getUnchecked((first + i) % workers.size())->queue.push(slot)) {
+            signal.post();
+            return true;
+        }
+    }
+
+    slots[slot].state.store((int) State::idle, std::memory_order_release);
+    return false;
+}
+
+bool WorkerPool::claim(int slot)
+{
+    int expected = (int) State::queued;
+    return slots[slot].state.compare_exchange_strong(expected, (int) State::running, std::memory_order_acq_rel);
+}
+
+bool WorkerPool::findWork(int workerIndex, int& slot)
+{
+    // own queue first, then the others'
+    for (int i = 0; i < workers.size(); ++i) {
+        if (workers.getUnchecked((workerIndex + i) % workers.size())->queue.pop(slot))
+            return true;
+    }
+
+    return false;
+}
+
+void WorkerPool::runSlot(int slot)
+{
+    // The owner may have claimed the job back, collected it and submitted it
+    // again since this entry was queued; then this entry runs the new
+    // submission and the newer entry finds nothing left to do.
+    if (! claim(slot))
+        return;
+
+    if (auto* job = slots[slot].job.load(std::memory_order_acquire))
+        job->run();
+
+    slots[slot].state.store((int) State::done, std::memory_order_release);
+}
@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+
+    WorkerPool.h
+
+    A process-wide pool of high-priority worker threads that every plugin
+    instance in the process shares through a SharedResourcePointer, so ten
+    instances do not start ten sets of threads. Each worker has its own
+    lock-free queue and steals from the others when it runs dry.
+
+    Jobs live in slots owned by the pool. An instance takes its slots when it
+    prepares and gives them back when it is destroyed; in between, the audio
+    thread only ever submits, polls and claims its slot, none of which
+    allocates, locks or waits.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#if JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#elif ! JUCE_WINDOWS
+ #include <semaphore.h>
+#endif
+
+//==============================================================================
+/**
+*/
+class WorkerPool
+{
+public:
+    struct Job
+    {
+        virtual ~Job() = default;
+        virtual void run() = 0;
+    };
+
+    enum class State
+    {
+        idle,       // free to submit
+        queued,     // waiting for a worker, or for the owner to claim it back
+        running,
+        done,       // finished by a worker, waiting for the owner to collect it
+        removed
+    };
+
+    static constexpr int maxJobs = 256;
+    static constexpr int maxWorkers = 8;
+
+    WorkerPool();
+    ~WorkerPool();
+
+    int getNumWorkers() const { return workers.size(); }
+
+    // message thread: returns a slot for the job, or -1 if the pool is full
+    int addJob(Job& job);
+
+    // Message thread: waits for the job if a worker is running it, then
+    // frees the slot. Stale queue entries for it are skipped.
+    void removeJob(int slot);
+
+    // Audio thread. An idle job is queued and a worker woken; false if the
+    // queues are full, in which case the caller runs the job itself.
+    bool submit(int slot);
+
+    State getState(int slot) const { return (State) slots[slot].state.load(std::memory_order_acquire); }
+
+    // Audio thread: takes a queued job back before a worker starts it. The
+    // caller runs it and then calls collect().
+    bool claim(int slot);
+
+    // audio thread: a finished or claimed job becomes idle again
+    void collect(int slot) { slots[slot].state.store((int) State::idle, std::memory_order_release); }
+
+private:
+    //==============================================================================
+    // Bounded multi-producer, multi-consumer queue of slot numbers (after
+    // Dmitry Vyukov's design): one compare-and-swap per push or pop.
+    class Queue
+    {
+    public:
+        static constexpr int capacity = 64;
+
+        Queue();
+        bool push(int value);
+        bool pop(int& value);
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence{ 0 };
+            int value = 0;
+        };
+
+        Cell cells[capacity];
+        alignas(64) std::atomic<size_t> enqueuePosition{ 0 };
+        alignas(64) std::atomic<size_t> dequeuePosition{ 0 };
+    };
+
+    // Counting wake-up signal: every post lets one wait through, so jobs
+    // submitted together wake as many workers. Posting takes no lock, so
+    // the audio thread can do it: a Win32 semaphore on Windows, a dispatch
+    // semaphore on macOS and a POSIX one elsewhere.
+    class Signal
+    {
+    public:
+        Signal();
+        ~Signal();
+        void post();
+        void wait(int timeoutMs);
+
+    private:
+       #if JUCE_WINDOWS
+        void* semaphore = nullptr;  // HANDLE, keeping windows.h out of the header
+       #elif JUCE_MAC || JUCE_IOS
+        dispatch_semaphore_t semaphore;
+       #else
+        sem_t semaphore;
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE (Signal)
+    };
+
+    class Worker  : public juce::Thread
+    {
+    public:
+        Worker(WorkerPool& owner, int index);
+        void run() override;
+
+        Queue queue;
+
+    private:
+        WorkerPool& pool;
+        const int index;
+    };
+
+    struct Slot
+    {
+        std::atomic<Job*> job{ nullptr };
+        std::atomic<int> state{ (int) State::removed };
+    };
+
+    // runs a slot taken from a queue, unless its owner got there first
+    void runSlot(int slot);
+    bool findWork(int workerIndex, int& slot);
+
+    Slot slots[maxJobs];
+    juce::OwnedArray<Worker> workers;
+    std::atomic<unsigned int> nextWorker{ 0 };
+    Signal signal;
+    juce::CriticalSection slotLock;     // addJob() and removeJob() only
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WorkerPool)
+};
@@ -0,0 +1,269 @@
+/*
+  ==============================================================================
+
+    BatchRender.cpp
+
+    Renders audio files through the chorus without a host, for batch jobs
+    over many stems. It runs in parallel per file, not per channel: the
+    files are queued longest first on a thread pool with a thread per core,
+    and each job streams all the channels of its file through its own
+    ChorusDSP in large chunks, so no file is ever held in memory whole. A
+    single file renders on one thread. The output keeps the
+    input's format, channel count and length, with the wet path's latency
+    taken off the front. Reports the throughput as a multiple of realtime.
+
+    Usage: BatchRender --output-dir=dir [--engine=rubberband|delayline|granular]
+                       [--delay=0] [--pitch=5] [--lfo-frequency=1] [--lfo-depth=10]
+                       [--voices=1] [--mix=50] [--feedback=0] [--output-gain=0]
+                       [--threads=cores] [--chunk=65536] files...
+
+    --mix and --feedback are percentages and --output-gain is in dB, as on
+    the plugin's controls.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../Source/ChorusDSP.h"
+
+namespace
+{
+    struct EngineChoice
+    {
+        const char* name;
+        int mode;
+    };
+
+    const EngineChoice engines[] = {
+        { "rubberband", ChorusDSP::pitchShiftEngine },
+        { "delayline",  ChorusDSP::delayLineEngine },
+        { "granular",   ChorusDSP::granularEngine },
+    };
+
+    struct Result
+    {
+        bool ok = false;
+        juce::String error;
+        double audioSeconds = 0.0;
+        double renderSeconds = 0.0;
+    };
+
+    //==============================================================================
+    class RenderJob  : public juce::ThreadPoolJob
+    {
+    public:
+        RenderJob(const juce::File& input, const juce::File& output, const ChorusDSP::Parameters& params, int chunk)
+            : juce::ThreadPoolJob(input.getFileName()), inputFile(input), outputFile(output),
+              parameters(params), chunkSize(chunk)
+        {
+        }
+
+        JobStatus runJob() override
+        {
+            auto start = juce::Time::getHighResolutionTicks();
+            result.error = render();
+            result.ok = result.error.isEmpty();
+            result.renderSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+            return jobHasFinished;
+        }
+
+        const juce::File inputFile;
+        const juce::File outputFile;
+        Result result;
+
+    private:
+        // returns an error message, or an empty string once the file is written
+        juce::String render()
+        {
+            juce::AudioFormatManager formats;
+            formats.registerBasicFormats();
+
+            std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(inputFile));
+
+            if (reader == nullptr)
+                return "cannot read the file";
+
+            int numChannels = (int) reader->numChannels;
+
+            if (numChannels < 1 || numChannels > ChorusDSP::maxChannels)
+                return "unsupported channel count " + juce::String(numChannels);
+
+            auto* format = formats.findFormatForFileExtension(outputFile.getFileExtension());
+
+            if (format == nullptr)
+                return "no writer for " + outputFile.getFileExtension();
+
+            // FLAC has no float samples, so anything it cannot hold is written at 24 bits
+            int bitsPerSample = format->getPossibleBitDepths().contains((int) reader->bitsPerSample) ? (int) reader->bitsPerSample : 24;
+
+            outputFile.deleteFile();
+            std::unique_ptr<juce::FileOutputStream> stream(outputFile.createOutputStream());
+
+            if (stream == nullptr)
+                return "cannot create " + outputFile.getFullPathName();
+
+            std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), reader->sampleRate,
+                                                                                    (unsigned int) numChannels, bitsPerSample, {}, 0));
+
+            if (writer == nullptr)
+                return "cannot write " + outputFile.getFileExtension() + " at this rate and depth";
+
+            stream.release();   // the writer owns it now
+
+            ChorusDSP chorus;
+            chorus.prepare(reader->sampleRate, chunkSize, numChannels, numChannels, {}, parameters);
+            chorus.setParameters(parameters);
+            chorus.setNonRealtime(true);
+
+            // Reading past the end gives silence, which flushes the latency
+            // out of the engine. Nothing changes the engine mid-file, so the
+            // latency stays what it was after prepare.
+            juce::AudioBuffer<float> buffer(numChannels, chunkSize);
+            const juce::int64 length = reader->lengthInSamples;
+            juce::int64 readPosition = 0;
+            juce::int64 written = 0;
+            const int latency = chorus.getLatencySamples();
+            int samplesToSkip = latency;
+
+            while (written < length) {
+                if (shouldExit())
+                    return "cancelled";
+
+                int numSamples = (int) juce::jmin((juce::int64) chunkSize, length + latency - readPosition);
+                reader->read(&buffer, 0, numSamples, readPosition, true, true);
+                chorus.process(buffer.getArrayOfReadPointers(), buffer.getArrayOfWritePointers(), numSamples);
+                readPosition += numSamples;
+
+                int skipped = juce::jmin(samplesToSkip, numSamples);
+                samplesToSkip -= skipped;
+
+                int numToWrite = (int) juce::jmin((juce::int64) (numSamples - skipped), length - written);
+
+                if (numToWrite > 0 && ! writer->writeFromAudioSampleBuffer(buffer, skipped, numToWrite))
+                    return "write failed";
+
+                written += numToWrite;
+            }
+
+            result.audioSeconds = (double) length / reader->sampleRate;
+            return {};
+        }
+
+        const ChorusDSP::Parameters parameters;
+        const int chunkSize;
+    };
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    if (! args.containsOption("--output-dir")) {
+        std::fprintf(stderr, "Usage: BatchRender --output-dir=dir [--engine=rubberband|delayline|granular] [options] files...\n");
+        return 1;
+    }
+
+    juce::File outputDir(args.getValueForOption("--output-dir"));
+
+    if (! outputDir.createDirectory()) {
+        std::fprintf(stderr, "Could not create %s\n", outputDir.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    ChorusDSP::Parameters params;
+    params.engine = ChorusDSP::pitchShiftEngine;
+
+    if (args.containsOption("--engine")) {
+        auto name = args.getValueForOption("--engine");
+        auto* engine = std::find_if(std::begin(engines), std::end(engines), [&](const EngineChoice& e) { return name == e.name; });
+
+        if (engine == std::end(engines)) {
+            std::fprintf(stderr, "Unknown engine %s\n", name.toRawUTF8());
+            return 1;
+        }
+
+        params.engine = engine->mode;
+    }
+
+    auto getFloat = [&](const char* option, float fallback) {
+        return args.containsOption(option) ? args.getValueForOption(option).getFloatValue() : fallback;
+    };
+
+    params.delayMs = juce::jlimit((float) -ChorusDSP::maxDelayMs, (float) ChorusDSP::maxDelayMs, getFloat("--delay", params.delayMs));
+    params.pitchCents = juce::jlimit(-ChorusDSP::maxPitchCents, ChorusDSP::maxPitchCents, getFloat("--pitch", params.pitchCents));
+    params.lfoFrequency = getFloat("--lfo-frequency", params.lfoFrequency);
+    params.lfoDepthCents = juce::jlimit(0.0f, ChorusDSP::maxLfoDepthCents, getFloat("--lfo-depth", params.lfoDepthCents));
+    params.numVoices = juce::jlimit(1, ChorusDSP::maxVoices, (int) getFloat("--voices", (float) params.numVoices));
+    params.mix = juce::jlimit(0.0f, 1.0f, getFloat("--mix", 100.0f * params.mix) / 100.0f);
+    params.feedback = juce::jlimit(0.0f, ChorusDSP::maxFeedback, getFloat("--feedback", 100.0f * params.feedback) / 100.0f);
+    params.outputGainDb = getFloat("--output-gain", params.outputGainDb);
+
+    int numThreads = args.containsOption("--threads") ? juce::jmax(1, args.getValueForOption("--threads").getIntValue())
+                                                      : juce::SystemStats::getNumCpus();
+    int chunkSize = args.containsOption("--chunk") ? juce::jmax(256, args.getValueForOption("--chunk").getIntValue()) : 65536;
+
+    juce::OwnedArray<RenderJob> jobs;
+
+    for (auto& arg : args.arguments) {
+        if (arg.isOption())
+            continue;
+
+        auto input = arg.resolveAsFile();
+        auto output = outputDir.getChildFile(input.getFileName());
+
+        if (output == input) {
+            std::fprintf(stderr, "Skipping %s: the output would overwrite it\n", input.getFullPathName().toRawUTF8());
+            continue;
+        }
+
+        jobs.add(new RenderJob(input, output, params, chunkSize));
+    }
+
+    if (jobs.isEmpty()) {
+        std::fprintf(stderr, "No input files\n");
+        return 1;
+    }
+
+    // the longest files go first, so the last one to start does not hold up the batch
+    std::sort(jobs.begin(), jobs.end(), [](const RenderJob* a, const RenderJob* b) {
+        return a->inputFile.getSize() > b->inputFile.getSize();
+    });
+
+    auto start = juce::Time::getHighResolutionTicks();
+
+    {
+        juce::ThreadPool pool(numThreads);
+
+        for (auto* job : jobs)
+            pool.addJob(job, false);
+
+        for (auto* job : jobs)
+            pool.waitForJobToFinish(job, -1);
+    }
+
+    double wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+    double totalAudioSeconds = 0.0;
+    int failures = 0;
+
+    for (auto* job : jobs) {
+        auto& result = job->result;
+
+        if (result.ok) {
+            totalAudioSeconds += result.audioSeconds;
+            std::printf("%-40s %9.1f s  %8.1fx realtime\n", job->inputFile.getFileName().toRawUTF8(),
+                        result.audioSeconds, result.audioSeconds / juce::jmax(1.0e-9, result.renderSeconds));
+        }
+        else {
+            ++failures;
+            std::fprintf(stderr, "%s: %s\n", job->inputFile.getFullPathName().toRawUTF8(), result.error.toRawUTF8());
+        }
+    }
+
+    std::printf("%d files, %.1f s of audio in %.2f s on %d threads: %.1fx realtime\n",
+                jobs.size() - failures, totalAudioSeconds, wallSeconds, numThreads,
+                totalAudioSeconds / juce::jmax(1.0e-9, wallSeconds));
+
+    return failures == 0 ? 0 : 1;
+}